@@ -2,8 +2,11 @@ struct buf;
 struct context;
 struct file;
 struct inode;
+struct memstat;
+struct mru_victim;
 struct pipe;
 struct proc;
+struct schedstat;
 struct spinlock;
 struct sleeplock;
 struct stat;
@@ -12,20 +15,33 @@ struct superblock;
 
 // swap.c
 void            swapinit(void);
-int             swapout(int, uint64, char*);
-int             swapin(int, uint64, char*);
+int             swapalloc(void);
+void            swapwritev(int*, char**, int);
+int             swapin(int, char*);
+int             swapinv(int*, char**, int);
+void            swapdup(int);
 void            swapfree(int);
 
 // mru.c
 void            mruinit(void);
-void            mruadd(int, uint64, uint64);
-void            mruremove(uint64);
-void            mruupdate(int, uint64);
-struct mru_entry* mruevict(void);
+int             mruadd(struct proc*, uint64, uint64, pte_t*, int, struct proc*);
+pte_t           mruunmap(pte_t*);
+int             mrushare(struct proc*, uint64, pte_t*, pte_t*);
+int             mrucow(struct proc*, uint64, pte_t*, char*);
+void            mruupdate(uint64);
+uint64          mrupin(pte_t*, int);
+void            mruunpin(uint64);
+int             mruevict(struct mru_victim*, int);
+int             mrusetpolicy(int);
+void            mruscan(void);
 void            mrudump(void);
-void            mrufree(int);
+void            mrufree(struct proc*);
 
 
+// kswapd.c
+void            kswapdinit(void);
+void            kswapd_wake(void);
+
 // bio.c
 void            binit(void);
 struct buf*     bread(uint, uint);
@@ -75,12 +91,25 @@ void            ireclaim(int);
 // kalloc.c
 void*           kalloc(void);
 void            kfree(void *);
+int             kderef(void *);
+void            krefpage(void *);
+int             krefcount(void *);
+void*           kalloc_zeroed(void);
+void            kzerodinit(void);
+void*           kalloc_order(int);
+void            kfree_order(void *, int);
+void            kmemstat(struct memstat*);
 void            kinit(void);
 int             can_alloc_user_page(void);  
 void            inc_user_pages(void);       
 void            dec_user_pages(void);  
 int             get_user_page_count(void);     
 
+// kmalloc.c
+void            kmallocinit(void);
+void*           kmalloc(uint);
+void            kmfree(void *);
+
 // log.c
 void            initlog(int, struct superblock*);
 void            log_write(struct buf*);
@@ -119,9 +148,15 @@ void            userinit(void);
 int             kwait(uint64);
 void            wakeup(void*);
 void            yield(void);
+void            setrunnable(struct proc*, int);
+void            schedboost(void);
+int             schedtick(void);
+int             setpriority(int, int);
+int             getschedstat(int, struct schedstat*);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
+int             kthread(char*, void (*)(void));
 
 // swtch.S
 void            swtch(struct context*, struct context*);
@@ -157,12 +192,26 @@ int             fetchstr(uint64, char*, int);
 int             fetchaddr(uint64, uint64*);
 void            syscall();
 
+// tlb.c
+void            tlbpoll(void);
+void            tlbflush(struct proc*, uint64);
+void            tlbflushall(struct proc*);
+
+// timer.c
+void            tickinit(void);
+int             kpause(int);
+int             kusleep(uint64);
+void            timerexpire(void);
+uint64          timetick(uint64);
+uint64          nexttimer(int);
+
 // trap.c
 extern uint     ticks;
 void            trapinit(void);
 void            trapinithart(void);
 extern struct spinlock tickslock;
 void            prepare_return(void);
+void            ipi(int);
 
 // uart.c
 void            uartinit(void);
@@ -179,7 +228,7 @@ int             mappages(pagetable_t, uint64, uint64, uint64, int);
 pagetable_t     uvmcreate(void);
 uint64          uvmalloc(pagetable_t, uint64, uint64, int);
 uint64          uvmdealloc(pagetable_t, uint64, uint64);
-int             uvmcopy(pagetable_t, pagetable_t, uint64);
+int             uvmcopy(pagetable_t, pagetable_t, uint64, struct proc*);
 void            uvmfree(pagetable_t, uint64);
 void            uvmunmap(pagetable_t, uint64, uint64, int);
 void            uvmclear(pagetable_t, uint64);
@@ -190,10 +239,9 @@ int             copyin(pagetable_t, char *, uint64, uint64);
 int             copyinstr(pagetable_t, char *, uint64, uint64);
 int             ismapped(pagetable_t, uint64);
 uint64          vmfault(pagetable_t, uint64, int);
-int             handle_page_fault(uint64);
-void            track_page_access(pagetable_t, uint64);
-int             evict_page(void);
-struct proc*    findproc(int);
+uint64          uvmpin(pagetable_t, uint64, int);
+int             handle_page_fault(uint64, int);
+int             evict_pages(int);
 
 // plic.c
 void            plicinit(void);
@@ -204,7 +252,9 @@ void            plic_complete(int);
 // virtio_disk.c
 void            virtio_disk_init(void);
 void            virtio_disk_rw(struct buf *, int);
+void            virtio_disk_rwpages(uint*, char**, int, int);
 void            virtio_disk_intr(void);
+uint64          virtio_disk_capacity(void);
 
 // number of elements in fixed-size array
 #define NELEM(x) (sizeof(x)/sizeof((x)[0]))
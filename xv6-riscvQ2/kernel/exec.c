@@ -133,6 +133,7 @@ kexec(char *path, char **argv)
   p->sz = sz;
   p->trapframe->epc = elf.entry;  // initial program counter = ulib.c:start()
   p->trapframe->sp = sp; // initial stack pointer
+  tlbflushall(p);  // the new page table has the same ASID
   proc_freepagetable(oldpagetable, oldsz);
 
   return argc; // this ends up in a0, the first argument to main(argc, argv)
@@ -154,18 +155,21 @@ kexec(char *path, char **argv)
 static int
 loadseg(pagetable_t pagetable, uint64 va, struct inode *ip, uint offset, uint sz)
 {
-  uint i, n;
+  uint i, n, r;
   uint64 pa;
 
   for(i = 0; i < sz; i += PGSIZE){
-    pa = walkaddr(pagetable, va + i);
-    if(pa == 0)
-      panic("loadseg: address should exist");
+    // the page may have been swapped out since uvmalloc(), and
+    // must not be while the disk fills it.
+    if((pa = uvmpin(pagetable, va + i, 1)) == 0)
+      return -1;
     if(sz - i < PGSIZE)
       n = sz - i;
     else
       n = PGSIZE;
-    if(readi(ip, 0, (uint64)pa, offset+i, n) != n)
+    r = readi(ip, 0, (uint64)pa, offset+i, n);
+    mruunpin(pa);
+    if(r != n)
       return -1;
   }
   
@@ -1,6 +1,9 @@
 // Physical memory allocator, for user processes,
 // kernel stacks, page-table pages,
-// and pipe buffers. Allocates whole 4096-byte pages.
+// and pipe buffers. A buddy allocator hands out
+// physically contiguous blocks of 2^order pages,
+// and single 4096-byte pages come from per-CPU
+// lists in front of it.
 
 #include "types.h"
 #include "param.h"
@@ -8,27 +11,79 @@
 #include "spinlock.h"
 #include "riscv.h"
 #include "defs.h"
+#include "memstat.h"
+#include "sched.h"
 
 void freerange(void *pa_start, void *pa_end);
+static void buddyfree(void *pa, int k);
+static struct run *zpop(void);
 
 extern char end[]; // first address after kernel.
                    // defined by kernel.ld.
 
 struct run {
   struct run *next;
+  struct run *prev;  // on buddy free lists only
 };
 
+// Buddy allocator: a free block of 2^k pages is on free[k], and
+// its first page's info[] says so. Blocks are aligned to their
+// size relative to KERNBASE, so a block's buddy is found by
+// flipping one bit of its page number; two free buddies merge.
+#define PAGEPA(i) ((struct run*)(KERNBASE + (uint64)(i) * PGSIZE))
+#define FREEBLOCK 0x80  // in info[], with the block's order
+
+struct {
+  struct spinlock lock;
+  struct run *free[NORDER];
+  int nblocks[NORDER];
+  uchar info[NPAGES];
+} buddy;
+
+// Each CPU frees single pages to and allocates them from its
+// own list, so CPUs don't contend for a lock. One that runs dry
+// takes a batch from the buddy allocator, or failing that from
+// the other CPUs, and one with too many gives a batch back.
 struct {
   struct spinlock lock;
   struct run *freelist;
-  int num_user_pages;
-} kmem;
+  int nfree;
+} kmem[NCPU];
+
+#define NBATCH 32  // pages moved to or from a CPU's list at once
+
+// Zeroed pages for kalloc_zeroed(), filled by kzerod. They are
+// allocated, with a reference each, while in the pool.
+struct {
+  struct spinlock lock;
+  struct run *list;
+  int n;
+} zpool;
+
+// User pages in use, checked against MAXUSERVMPAGES. Updated
+// with atomic instructions rather than under a lock.
+int num_user_pages;
+
+// A user page can be mapped by several processes at once
+// after a copy-on-write fork; it is freed when the last
+// reference goes. Counts are updated atomically.
+struct {
+  int refcount[NPAGES];
+} kmem_ref;
 
 void
 kinit()
 {
-  initlock(&kmem.lock, "kmem");
-  kmem.num_user_pages = 0;
+  initlock(&buddy.lock, "buddy");
+  initlock(&zpool.lock, "zpool");
+  zpool.list = 0;
+  zpool.n = 0;
+  for(int i = 0; i < NCPU; i++){
+    initlock(&kmem[i].lock, "kmem");
+    kmem[i].freelist = 0;
+    kmem[i].nfree = 0;
+  }
+  num_user_pages = 0;
   freerange(end, (void*)PHYSTOP);
 }
 
@@ -37,8 +92,187 @@ freerange(void *pa_start, void *pa_end)
 {
   char *p;
   p = (char*)PGROUNDUP((uint64)pa_start);
+  acquire(&buddy.lock);
   for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE)
-    kfree(p);
+    buddyfree(p, 0);
+  release(&buddy.lock);
+}
+
+// Put the free block of 2^k pages at r on free[k].
+// Caller must hold buddy.lock.
+static void
+push(struct run *r, int k)
+{
+  r->prev = 0;
+  r->next = buddy.free[k];
+  if(r->next)
+    r->next->prev = r;
+  buddy.free[k] = r;
+  buddy.nblocks[k]++;
+  buddy.info[PAGENO(r)] = FREEBLOCK | k;
+}
+
+// Take the free block of 2^k pages at r off free[k].
+// Caller must hold buddy.lock.
+static void
+unlink(struct run *r, int k)
+{
+  if(r->prev)
+    r->prev->next = r->next;
+  else
+    buddy.free[k] = r->next;
+  if(r->next)
+    r->next->prev = r->prev;
+  buddy.nblocks[k]--;
+  buddy.info[PAGENO(r)] = 0;
+}
+
+// Free the block of 2^k pages at pa, merging it with its buddy
+// for as long as that is free too.
+// Caller must hold buddy.lock.
+static void
+buddyfree(void *pa, int k)
+{
+  uint64 i = PAGENO(pa);
+
+  while(k < MAXORDER){
+    uint64 b = i ^ (1L << k);
+    if(b >= NPAGES || buddy.info[b] != (FREEBLOCK | k))
+      break;
+    unlink(PAGEPA(b), k);
+    i &= ~(1L << k);
+    k++;
+  }
+  push(PAGEPA(i), k);
+}
+
+// Allocate a block of 2^k pages, splitting a bigger one if
+// need be. Returns 0 if there is none.
+// Caller must hold buddy.lock.
+static struct run*
+buddyalloc(int k)
+{
+  struct run *r;
+  int j;
+
+  for(j = k; j <= MAXORDER && buddy.free[j] == 0; j++)
+    ;
+  if(j > MAXORDER)
+    return 0;
+  r = buddy.free[j];
+  unlink(r, j);
+  // give back the upper halves.
+  while(j > k){
+    j--;
+    push(PAGEPA(PAGENO(r) + (1L << j)), j);
+  }
+  return r;
+}
+
+// Give every page on the per-CPU lists back to the buddy
+// allocator, so that they can merge into bigger blocks.
+static void
+drain(void)
+{
+  struct run *r, *next;
+
+  for(int i = 0; i < NCPU; i++){
+    acquire(&kmem[i].lock);
+    r = kmem[i].freelist;
+    kmem[i].freelist = 0;
+    kmem[i].nfree = 0;
+    release(&kmem[i].lock);
+
+    acquire(&buddy.lock);
+    for(; r; r = next){
+      next = r->next;
+      buddyfree(r, 0);
+    }
+    release(&buddy.lock);
+  }
+}
+
+// Allocate 2^order physically contiguous pages, aligned to
+// their size. Nothing in the kernel needs more than a page yet;
+// this and kfree_order() are here for callers that will, and
+// memstat() shows what they could get.
+// Returns a pointer that the kernel can use, or 0 if there is
+// no free block that big.
+void *
+kalloc_order(int order)
+{
+  struct run *r;
+
+  if(order < 0 || order > MAXORDER)
+    return 0;
+
+  acquire(&buddy.lock);
+  r = buddyalloc(order);
+  release(&buddy.lock);
+  if(r == 0){
+    // pages on the per-CPU lists can't merge; give them back.
+    drain();
+    acquire(&buddy.lock);
+    r = buddyalloc(order);
+    release(&buddy.lock);
+  }
+
+#ifdef KDEBUG
+  if(r)
+    memset((char*)r, 5, PGSIZE << order); // fill with junk
+#endif
+  return (void*)r;
+}
+
+// Free a block from kalloc_order(order).
+void
+kfree_order(void *pa, int order)
+{
+  if(((uint64)pa % (PGSIZE << order)) != 0 || (char*)pa < end ||
+     (uint64)pa + (PGSIZE << order) > PHYSTOP)
+    panic("kfree_order");
+
+#ifdef KDEBUG
+  // Fill with junk to catch dangling refs.
+  memset(pa, 1, PGSIZE << order);
+#endif
+
+  acquire(&buddy.lock);
+  buddyfree(pa, order);
+  release(&buddy.lock);
+}
+
+// Report free memory, for the memstat() system call.
+void
+kmemstat(struct memstat *st)
+{
+  st->cached = 0;
+  for(int i = 0; i < NCPU; i++){
+    acquire(&kmem[i].lock);
+    st->cached += kmem[i].nfree;
+    release(&kmem[i].lock);
+  }
+  st->free = st->cached;
+  acquire(&buddy.lock);
+  for(int k = 0; k < NORDER; k++){
+    st->blocks[k] = buddy.nblocks[k];
+    st->free += (uint64)buddy.nblocks[k] << k;
+  }
+  release(&buddy.lock);
+}
+
+// Take another reference to a page from kalloc().
+void
+krefpage(void *pa)
+{
+  __sync_fetch_and_add(&kmem_ref.refcount[PAGENO(pa)], 1);
+}
+
+// Number of references to a page from kalloc().
+int
+krefcount(void *pa)
+{
+  return __atomic_load_n(&kmem_ref.refcount[PAGENO(pa)], __ATOMIC_SEQ_CST);
 }
 
 // Free the page of physical memory pointed at by pa,
@@ -47,21 +281,112 @@ freerange(void *pa_start, void *pa_end)
 // initializing the allocator; see kinit above.)
 void
 kfree(void *pa)
+{
+  kderef(pa);
+}
+
+// Drop a reference to pa, freeing the page with the last one.
+// Returns the number of references left.
+int
+kderef(void *pa)
 {
   struct run *r;
 
   if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
     panic("kfree");
 
+  int n = __sync_sub_and_fetch(&kmem_ref.refcount[PAGENO(pa)], 1);
+  if(n < 0)
+    panic("kfree: refcount");
+  if(n > 0)
+    return n;
+
+#ifdef KDEBUG
   // Fill with junk to catch dangling refs.
   memset(pa, 1, PGSIZE);
+#endif
 
   r = (struct run*)pa;
 
-  acquire(&kmem.lock);
-  r->next = kmem.freelist;
-  kmem.freelist = r;
-  release(&kmem.lock);
+  push_off();
+  int id = cpuid();
+  struct run *back = 0;
+  acquire(&kmem[id].lock);
+  r->next = kmem[id].freelist;
+  kmem[id].freelist = r;
+  if(++kmem[id].nfree > 2*NBATCH){
+    // too many: give NBATCH of them back.
+    back = kmem[id].freelist;
+    for(int i = 0; i < NBATCH; i++)
+      kmem[id].freelist = kmem[id].freelist->next;
+    kmem[id].nfree -= NBATCH;
+  }
+  release(&kmem[id].lock);
+  pop_off();
+
+  if(back){
+    acquire(&buddy.lock);
+    for(int i = 0; i < NBATCH; i++){
+      r = back;
+      back = back->next;
+      buddyfree(r, 0);
+    }
+    release(&buddy.lock);
+  }
+  return 0;
+}
+
+// This CPU's list is empty: refill it with up to NBATCH pages
+// from the buddy allocator, or if that is out of pages, from the
+// first other CPU that has some, half of what it has at most.
+// Only one lock is held at a time.
+// Returns a page for the caller to use, or 0.
+// Caller must have interrupts off.
+static struct run*
+refill(int id)
+{
+  struct run *r, *last;
+  int n;
+
+  acquire(&buddy.lock);
+  r = 0;
+  for(n = 0; n < NBATCH; n++){
+    if((last = buddyalloc(0)) == 0)
+      break;
+    last->next = r;
+    r = last;
+  }
+  release(&buddy.lock);
+
+  for(int i = 1; n == 0 && i < NCPU; i++){
+    int victim = (id + i) % NCPU;
+    acquire(&kmem[victim].lock);
+    r = kmem[victim].freelist;
+    if(r){
+      n = (kmem[victim].nfree + 1) / 2;
+      last = r;
+      for(int j = 1; j < n; j++)
+        last = last->next;
+      kmem[victim].freelist = last->next;
+      kmem[victim].nfree -= n;
+      last->next = 0;
+    }
+    release(&kmem[victim].lock);
+  }
+  if(n == 0)
+    return 0;
+
+  // keep the first, and put the rest on our list.
+  if(n > 1){
+    for(last = r; last->next; last = last->next)
+      ;
+    acquire(&kmem[id].lock);
+    last->next = kmem[id].freelist;
+    kmem[id].freelist = r->next;
+    kmem[id].nfree += n - 1;
+    release(&kmem[id].lock);
+  }
+  return r;
 }
 
 // Allocate one 4096-byte page of physical memory.
@@ -72,52 +397,145 @@ kalloc(void)
 {
   struct run *r;
 
-  acquire(&kmem.lock);
-  r = kmem.freelist;
-  if(r)
-    kmem.freelist = r->next;
-  release(&kmem.lock);
+  push_off();
+  int id = cpuid();
+  acquire(&kmem[id].lock);
+  r = kmem[id].freelist;
+  if(r){
+    kmem[id].freelist = r->next;
+    kmem[id].nfree--;
+  }
+  release(&kmem[id].lock);
+  if(r == 0)
+    r = refill(id);
+  pop_off();
+  if(r == 0)
+    return (void*)zpop();  // last resort; already has its reference
 
+#ifdef KDEBUG
+  memset((char*)r, 5, PGSIZE); // fill with junk
+#endif
+  kmem_ref.refcount[PAGENO(r)] = 1;
+  return (void*)r;
+}
+
+// Take a page from the zeroed pool, or return 0.
+static struct run*
+zpop(void)
+{
+  struct run *r;
+
+  acquire(&zpool.lock);
+  r = zpool.list;
+  if(r){
+    zpool.list = r->next;
+    if(--zpool.n == NZEROPAGES / 2)
+      wakeup(&zpool);
+  }
+  release(&zpool.lock);
   if(r)
-    memset((char*)r, 5, PGSIZE); // fill with junk
+    r->next = 0;  // the only word that wasn't zero
+  return r;
+}
+
+// Like kalloc(), but the page is zeroed. It comes from the
+// pool kzerod keeps ready if there is one.
+void *
+kalloc_zeroed(void)
+{
+  struct run *r;
+
+  if((r = zpop()) != 0)
+    return (void*)r;
+  if((r = kalloc()) != 0)
+    memset((char*)r, 0, PGSIZE);
   return (void*)r;
 }
 
+// kzerod zeroes free pages in the background, ahead of
+// kalloc_zeroed(), so that the fault and sbrk paths don't have
+// to. When the pool falls to half full it tops it up to
+// NZEROPAGES, one page at a time, giving up the CPU between pages.
+// It runs at the lowest priority, so only when nothing more
+// important wants the CPU.
+static void
+kzerod(void)
+{
+  struct run *r;
+  int want;
+
+  for(;;){
+    // bounded, since with memory short kalloc() may take its
+    // page from the pool.
+    want = NZEROPAGES - zpool.n;
+    while(want-- > 0 && (r = kalloc()) != 0){
+      memset((char*)r, 0, PGSIZE);
+      acquire(&zpool.lock);
+      r->next = zpool.list;
+      zpool.list = r;
+      zpool.n++;
+      release(&zpool.lock);
+      yield();
+    }
+
+    acquire(&zpool.lock);
+    if(zpool.n < NZEROPAGES){
+      // memory is short, and kalloc() is drawing on the pool;
+      // try again a tick later.
+      release(&zpool.lock);
+      kpause(1);
+      continue;
+    }
+    while(zpool.n > NZEROPAGES / 2)
+      sleep(&zpool, &zpool.lock);
+    release(&zpool.lock);
+  }
+}
+
+void
+kzerodinit(void)
+{
+  int pid;
+
+  if((pid = kthread("kzerod", kzerod)) < 0)
+    panic("kzerodinit");
+  // it yields between pages, so would never use up a quantum
+  // and drop down the MLFQ on its own. boosts and disk wakeups
+  // only return a process to its base.
+  setpriority(pid, NPRIO - 1);
+}
+
 // Add function to check if we can allocate user page
 int
 can_alloc_user_page(void)
 {
-  acquire(&kmem.lock);
-  int can = (kmem.num_user_pages < MAXUSERVMPAGES);
-  release(&kmem.lock);
-  return can;
+  return get_user_page_count() < MAXUSERVMPAGES;
 }
 
 // Add function to increment user page count
 void
 inc_user_pages(void)
 {
-  acquire(&kmem.lock);
-  kmem.num_user_pages++;
-  release(&kmem.lock);
+  __sync_fetch_and_add(&num_user_pages, 1);
+  kswapd_wake();
 }
 
 // Add function to decrement user page count
 void
 dec_user_pages(void)
 {
-  acquire(&kmem.lock);
-  if(kmem.num_user_pages > 0)
-    kmem.num_user_pages--;
-  release(&kmem.lock);
+  int n;
+
+  do {
+    n = get_user_page_count();
+    if(n == 0)
+      return;
+  } while(!__sync_bool_compare_and_swap(&num_user_pages, n, n - 1));
 }
 
 // Get current user page count
 int
 get_user_page_count(void)
 {
-  acquire(&kmem.lock);
-  int count = kmem.num_user_pages;
-  release(&kmem.lock);
-  return count;
+  return __atomic_load_n(&num_user_pages, __ATOMIC_SEQ_CST);
 }
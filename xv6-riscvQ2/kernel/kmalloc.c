@@ -0,0 +1,158 @@
+// Allocator for small kernel objects.
+//
+// Requests of up to 2048 bytes are rounded up to a power-of-two
+// size class. Each class carves whole kalloc() pages into objects
+// and keeps the free ones on a list; the pages are never given
+// back. In front of each list, every CPU has a magazine of free
+// objects it can use without taking a lock, which it refills from
+// and spills to the list half a magazine at a time.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "riscv.h"
+#include "defs.h"
+
+extern char end[]; // first address after kernel.
+
+#define MINSHIFT 5    // smallest class: 32 bytes
+#define NCLASS   7    // ... up to 2048 bytes
+#define MAGSIZE  16   // objects in a full magazine
+
+struct obj {
+  struct obj *next;
+};
+
+struct {
+  struct spinlock lock;
+  struct obj *free;
+} kmclass[NCLASS];
+
+// a CPU's free objects of one class; only used with
+// interrupts off, by that CPU.
+struct magazine {
+  int n;
+  void *objs[MAGSIZE];
+} mags[NCPU][NCLASS];
+
+// class of each page carved into objects, for kmfree().
+uchar slabclass[NPAGES];
+
+void
+kmallocinit(void)
+{
+  for(int c = 0; c < NCLASS; c++){
+    initlock(&kmclass[c].lock, "kmalloc");
+    kmclass[c].free = 0;
+  }
+}
+
+// The smallest class whose objects hold size bytes.
+static int
+sizeclass(uint size)
+{
+  int c;
+
+  for(c = 0; c < NCLASS; c++){
+    if(size <= (1 << (c + MINSHIFT)))
+      return c;
+  }
+  panic("kmalloc: too big");
+  return -1;
+}
+
+// Fill magazine m of class c halfway from the class's list,
+// carving a fresh page if that runs out.
+// Caller must have interrupts off.
+static void
+refill(struct magazine *m, int c)
+{
+  int size = 1 << (c + MINSHIFT);
+  struct obj *o;
+  char *mem;
+
+  acquire(&kmclass[c].lock);
+  while(m->n < MAGSIZE / 2){
+    if(kmclass[c].free == 0){
+      if((mem = kalloc()) == 0)
+        break;
+      slabclass[PAGENO(mem)] = c;
+      for(int i = PGSIZE - size; i >= 0; i -= size){
+        o = (struct obj*)(mem + i);
+        o->next = kmclass[c].free;
+        kmclass[c].free = o;
+      }
+    }
+    o = kmclass[c].free;
+    kmclass[c].free = o->next;
+    m->objs[m->n++] = o;
+  }
+  release(&kmclass[c].lock);
+}
+
+// Put half of full magazine m of class c back on the class's list.
+// Caller must have interrupts off.
+static void
+spill(struct magazine *m, int c)
+{
+  struct obj *o;
+
+  acquire(&kmclass[c].lock);
+  while(m->n > MAGSIZE / 2){
+    o = m->objs[--m->n];
+    o->next = kmclass[c].free;
+    kmclass[c].free = o;
+  }
+  release(&kmclass[c].lock);
+}
+
+// Allocate size bytes, at most 2048, aligned to the size rounded
+// up to a power of two.
+// Returns a pointer that the kernel can use, or 0 if out of memory.
+void*
+kmalloc(uint size)
+{
+  int c = sizeclass(size);
+  void *p = 0;
+
+  push_off();
+  struct magazine *m = &mags[cpuid()][c];
+  if(m->n == 0)
+    refill(m, c);
+  if(m->n > 0)
+    p = m->objs[--m->n];
+  pop_off();
+
+#ifdef KDEBUG
+  if(p)
+    memset(p, 5, 1 << (c + MINSHIFT)); // fill with junk
+#endif
+  return p;
+}
+
+// Free an object from kmalloc().
+void
+kmfree(void *p)
+{
+  if((char*)p < end || (uint64)p >= PHYSTOP)
+    panic("kmfree");
+
+  int c = slabclass[PAGENO(p)];
+  int size = 1 << (c + MINSHIFT);
+
+  if(((uint64)p % size) != 0)
+    panic("kmfree");
+
+#ifdef KDEBUG
+  // Fill with junk to catch dangling refs.
+  memset(p, 1, size);
+#endif
+
+  push_off();
+  struct magazine *m = &mags[cpuid()][c];
+  if(m->n == MAGSIZE)
+    spill(m, c);
+  m->objs[m->n++] = p;
+  pop_off();
+}
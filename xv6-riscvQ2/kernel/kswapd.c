@@ -0,0 +1,66 @@
+// kernel/kswapd.c
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+// kswapd evicts user pages in the background so that page
+// faults and sbrk usually find a free user page ready, instead
+// of paying for a victim's swap-out themselves. It sleeps until
+// the number of free user pages drops below KSWAPD_LOW, then
+// evicts until KSWAPD_HIGH pages are free. uvmalloc() and
+// handle_page_fault() still evict synchronously if it falls behind.
+struct {
+  struct spinlock lock;
+  int wanted;  // someone saw free pages drop below KSWAPD_LOW
+} kswapd_state;
+
+static int
+free_user_pages(void)
+{
+  return MAXUSERVMPAGES - get_user_page_count();
+}
+
+static void
+kswapd(void)
+{
+  acquire(&kswapd_state.lock);
+  for(;;){
+    while(!kswapd_state.wanted)
+      sleep(&kswapd_state, &kswapd_state.lock);
+    kswapd_state.wanted = 0;
+    release(&kswapd_state.lock);
+
+    int want;
+    while((want = KSWAPD_HIGH - free_user_pages()) > 0){
+      if(evict_pages(want) == 0)
+        break;  // nothing evictable; wait to be asked again
+    }
+
+    acquire(&kswapd_state.lock);
+  }
+}
+
+// Called after a user page is allocated.
+void
+kswapd_wake(void)
+{
+  if(free_user_pages() >= KSWAPD_LOW)
+    return;
+  acquire(&kswapd_state.lock);
+  kswapd_state.wanted = 1;
+  wakeup(&kswapd_state);
+  release(&kswapd_state.lock);
+}
+
+void
+kswapdinit(void)
+{
+  initlock(&kswapd_state.lock, "kswapd");
+  kswapd_state.wanted = 0;
+  if(kthread("kswapd", kswapd) < 0)
+    panic("kswapdinit");
+}
@@ -17,10 +17,12 @@ main()
     printf("xv6 kernel is booting\n");
     printf("\n");
     kinit();         // physical page allocator
+    kmallocinit();   // small object allocator
     kvminit();       // create kernel page table
     kvminithart();   // turn on paging
     procinit();      // process table
     trapinit();      // trap vectors
+    tickinit();      // clock ticks and timer deadlines
     trapinithart();  // install kernel trap vector
     plicinit();      // set up interrupt controller
     plicinithart();  // ask PLIC for device interrupts
@@ -35,6 +37,8 @@ main()
 
 
     userinit();      // first user process
+    kswapdinit();    // background page eviction
+    kzerodinit();    // background page zeroing
     __sync_synchronize();
     started = 1;
   } else {
@@ -0,0 +1,9 @@
+// physical memory statistics, for memstat()
+#define MAXORDER  10  // biggest buddy block is 2^MAXORDER pages
+#define NORDER    (MAXORDER + 1)
+
+struct memstat {
+  uint64 free;            // free pages in all
+  uint64 cached;          // ... of which on per-CPU lists
+  uint64 blocks[NORDER];  // free buddy blocks of 2^i pages
+};
@@ -7,186 +7,785 @@
 #include "proc.h"
 #include "defs.h"
 #include "mru.h"
+#include "policy.h"
+
+// Every tracked resident user page has one mru_entry, on one of
+// the queues in q[] and found by physical address through
+// frame[], which is indexed like kmem_ref.refcount. The entry's
+// reverse map lists every PTE that maps the page, so eviction can
+// unmap a page shared by fork() without searching for its owners.
+// Which page to evict, and how queue order follows accesses, is
+// up to the current replacement policy.
+//
+// A resident user PTE that is on the list only changes with
+// mru_list.lock held, so that eviction, fork, copy-on-write and
+// unmapping can't cross; the reverse maps are protected by it too.
+// The hardware sets PTE_A and PTE_D in live PTEs without the lock,
+// so the kernel changes those bits with atomic operations.
+// The kernel reads and writes user pages through their physical
+// addresses, so it pins a page (mrupin()) for as long as it does;
+// eviction passes over pinned pages.
+// Entries and reverse map entries come from kmalloc().
+#define NGHOST 32     // evicted pages 2Q remembers
+
+struct queue {
+  struct mru_entry *head;  // most recently inserted
+  struct mru_entry *tail;
+  int n;
+};
+
+struct policy {
+  void (*add)(struct mru_entry*);      // e is new, not on a queue
+  void (*touch)(struct mru_entry*);    // e was accessed
+  struct mru_entry *(*victim)(void);   // choose a page to evict
+  void (*evict)(struct mru_entry*);    // e is being evicted, or 0
+  int harvest;  // have mruscan() turn PTE_A into touch() calls
+};
 
 struct {
   struct spinlock lock;
-  struct mru_entry *head;  // Most recently used
-  struct mru_entry *tail;  // Least recently used
+  struct queue q[2];
+  struct mru_entry *frame[NPAGES];
+  struct policy *policy;
+
+  // 2Q's A1out: (pid, va) of pages recently evicted from q[0].
+  struct {
+    int pid;
+    uint64 va;
+  } ghost[NGHOST];
+  int nextghost;
 } mru_list;
 
-#define MAX_MRU_ENTRIES 128
-struct mru_entry entries[MAX_MRU_ENTRIES];
-int entry_count = 0;
+extern char zeropage[]; // vm.c
+
+static struct mru_entry**
+frameof(uint64 pa)
+{
+  return &mru_list.frame[PAGENO(pa)];
+}
+
+// Put e at the head of queue qi.
+// Caller must hold mru_list.lock.
+static void
+enqueue(struct mru_entry *e, int qi)
+{
+  struct queue *q = &mru_list.q[qi];
+
+  e->queue = qi;
+  e->next = q->head;
+  e->prev = 0;
+  if(q->head)
+    q->head->prev = e;
+  q->head = e;
+  if(q->tail == 0)
+    q->tail = e;
+  q->n++;
+}
+
+// Take e off its queue only.
+// Caller must hold mru_list.lock.
+static void
+dequeue(struct mru_entry *e)
+{
+  struct queue *q = &mru_list.q[e->queue];
+
+  if(e->prev)
+    e->prev->next = e->next;
+  else
+    q->head = e->next;
+
+  if(e->next)
+    e->next->prev = e->prev;
+  else
+    q->tail = e->prev;
+  q->n--;
+}
+
+// Move e to the head of its queue.
+// Caller must hold mru_list.lock.
+static void
+requeue(struct mru_entry *e)
+{
+  int qi = e->queue;
+
+  if(e == mru_list.q[qi].head)
+    return;
+  dequeue(e);
+  enqueue(e, qi);
+}
+
+// Index e by its page and hand it to the policy.
+// Caller must hold mru_list.lock.
+static void
+insert(struct mru_entry *e)
+{
+  *frameof(e->pa) = e;
+  mru_list.policy->add(e);
+}
+
+// Take e off its queue and out of frame[].
+// Caller must hold mru_list.lock.
+static void
+delete(struct mru_entry *e)
+{
+  dequeue(e);
+  *frameof(e->pa) = 0;
+  e->next = e->prev = 0;
+}
+
+// Add the mapping at pte to e's reverse map.
+// Returns 0, or -1 if no rmap could be allocated.
+// Caller must hold mru_list.lock.
+static int
+mapadd(struct mru_entry *e, struct proc *p, uint64 va, pte_t *pte)
+{
+  struct rmap *m;
+
+  if((m = kmalloc(sizeof(struct rmap))) == 0)
+    return -1;
+  m->proc = p;
+  m->va = va;
+  m->pte = pte;
+  m->next = e->maps;
+  e->maps = m;
+  return 0;
+}
+
+// Take the mapping at pte out of e's reverse map. When the last
+// one goes, so does e, along with any swap copy it kept.
+// Caller must hold mru_list.lock.
+static void
+mapdel(struct mru_entry *e, pte_t *pte)
+{
+  struct rmap **mp, *m;
+
+  for(mp = &e->maps; (m = *mp) != 0; mp = &m->next){
+    if(m->pte == pte){
+      *mp = m->next;
+      kmfree(m);
+      break;
+    }
+  }
+  if(e->maps == 0){
+    if(e->slot >= 0)
+      swapfree(e->slot);
+    delete(e);
+    kmfree(e);
+  }
+}
+
+// Has any mapping of e been accessed (PTE_A)? If clear is set,
+// also clear the bits.
+// Caller must hold mru_list.lock.
+static int
+accessed(struct mru_entry *e, int clear)
+{
+  int a = 0;
+
+  for(struct rmap *m = e->maps; m; m = m->next){
+    if(*m->pte & PTE_A){
+      a = 1;
+      if(clear)
+        __sync_fetch_and_and(m->pte, ~PTE_A);
+    }
+  }
+  return a;
+}
+
+// Has any mapping of e written it (PTE_D)?
+// Caller must hold mru_list.lock.
+static int
+dirty(struct mru_entry *e)
+{
+  for(struct rmap *m = e->maps; m; m = m->next){
+    if(*m->pte & PTE_D)
+      return 1;
+  }
+  return 0;
+}
+
+//
+// Replacement policies. All of them keep new pages at the head
+// of q[0]; only 2Q uses q[1]. Called with mru_list.lock held.
+//
+// The kernel's own accesses (copyin/copyout, faults) reach touch()
+// directly. User loads and stores only set the hardware PTE_A bit,
+// which mruscan() turns into touch() calls for policies that ask,
+// and which CLOCK reads for itself.
+//
+
+static void
+addhead(struct mru_entry *e)
+{
+  enqueue(e, 0);
+}
+
+static void
+touchnone(struct mru_entry *e)
+{
+}
+
+static struct mru_entry*
+victimhead(void)
+{
+  return mru_list.q[0].head;
+}
+
+static struct mru_entry*
+victimtail(void)
+{
+  return mru_list.q[0].tail;
+}
+
+// CLOCK: sweep from the oldest page, clearing PTE_A and moving
+// referenced pages back to the head, until an unreferenced one
+// turns up. The TLB is not flushed, so a page in use may not get
+// its bit set again; that only makes CLOCK a little more eager.
+static void
+clocktouch(struct mru_entry *e)
+{
+  __sync_fetch_and_or(e->maps->pte, PTE_A);
+}
+
+static struct mru_entry*
+clockvictim(void)
+{
+  struct mru_entry *e;
+
+  // after one full sweep every bit is clear.
+  for(int i = 0; i <= mru_list.q[0].n; i++){
+    e = mru_list.q[0].tail;
+    if(e == 0 || !accessed(e, 1))
+      break;
+    requeue(e);
+  }
+  return mru_list.q[0].tail;
+}
+
+// 2Q: new pages go on a FIFO (q[0], A1in). A page evicted from
+// there is remembered in ghost[] (A1out); if it is swapped back
+// in while remembered it has proven itself and joins an LRU queue
+// (q[1], Am). A1in is kept to about a quarter of resident pages.
+// A page is known by its first mapping.
+static void
+twoqadd(struct mru_entry *e)
+{
+  int pid = e->maps->proc->pid;
+  uint64 va = e->maps->va;
+
+  for(int i = 0; i < NGHOST; i++){
+    if(mru_list.ghost[i].pid == pid && mru_list.ghost[i].va == va){
+      mru_list.ghost[i].pid = 0;
+      enqueue(e, 1);
+      return;
+    }
+  }
+  enqueue(e, 0);
+}
+
+static void
+twoqtouch(struct mru_entry *e)
+{
+  if(e->queue == 1)
+    requeue(e);
+}
+
+static struct mru_entry*
+twoqvictim(void)
+{
+  struct queue *a1 = &mru_list.q[0], *am = &mru_list.q[1];
+
+  if(am->tail && a1->n * 4 <= a1->n + am->n)
+    return am->tail;
+  if(a1->tail == 0)
+    return am->tail;
+  return a1->tail;
+}
+
+// Remember a page evicted from A1in. Only once mruevict() has
+// committed to it: a victim that is pinned, or that finds no swap
+// slot, stays resident and must not be taken for a returning page.
+static void
+twoqevict(struct mru_entry *e)
+{
+  if(e->queue != 0)
+    return;
+  mru_list.ghost[mru_list.nextghost].pid = e->maps->proc->pid;
+  mru_list.ghost[mru_list.nextghost].va = e->maps->va;
+  mru_list.nextghost = (mru_list.nextghost + 1) % NGHOST;
+}
+
+static struct policy policies[NPOLICY] = {
+[POLICY_MRU]   { addhead, requeue, victimhead, 0, 1 },
+[POLICY_LRU]   { addhead, requeue, victimtail, 0, 1 },
+[POLICY_FIFO]  { addhead, touchnone, victimtail, 0, 0 },
+[POLICY_CLOCK] { addhead, clocktouch, clockvictim, 0, 0 },
+[POLICY_2Q]    { twoqadd, twoqtouch, twoqvictim, twoqevict, 1 },
+};
+
+static char *policynames[NPOLICY] = POLICYNAMES;
 
 void
 mruinit(void)
 {
   initlock(&mru_list.lock, "mru");
-  mru_list.head = 0;
-  mru_list.tail = 0;
-  entry_count = 0;
+  for(int i = 0; i < 2; i++){
+    mru_list.q[i].head = 0;
+    mru_list.q[i].tail = 0;
+    mru_list.q[i].n = 0;
+  }
+  for(int i = 0; i < NPAGES; i++)
+    mru_list.frame[i] = 0;
+  mru_list.policy = &policies[POLICY_MRU];
+  for(int i = 0; i < NGHOST; i++)
+    mru_list.ghost[i].pid = 0;
+  mru_list.nextghost = 0;
 }
 
-// Add a page to the MRU list (makes it most recently used)
-void
-mruadd(int pid, uint64 va, uint64 pa)
+// Start tracking a page, just mapped at pte in process p; slot
+// is a swap slot holding an identical copy, or -1. If the page
+// was read ahead of a fault, ahead is the process that did it.
+// Returns 0 on success, -1 if no entry could be allocated.
+int
+mruadd(struct proc *p, uint64 va, uint64 pa, pte_t *pte, int slot, struct proc *ahead)
 {
   acquire(&mru_list.lock);
-  
-  if(entry_count >= MAX_MRU_ENTRIES) {
+
+  struct mru_entry *e = kmalloc(sizeof(struct mru_entry));
+  if(e == 0) {
     release(&mru_list.lock);
-    return;
+    return -1;
   }
-  
-  struct mru_entry *e = &entries[entry_count++];
-  e->pid = pid;
-  e->va = va;
+
   e->pa = pa;
-  e->next = mru_list.head;
-  e->prev = 0;
-  
-  if(mru_list.head)
-    mru_list.head->prev = e;
-  mru_list.head = e;
-  
-  if(mru_list.tail == 0)
-    mru_list.tail = e;
-  
+  e->maps = 0;
+  e->slot = slot;
+  e->ahead = ahead;
+  e->pin = 0;
+  if(mapadd(e, p, va, pte) < 0) {
+    kmfree(e);
+    release(&mru_list.lock);
+    return -1;
+  }
+  insert(e);
+
   release(&mru_list.lock);
+  return 0;
 }
 
-// Remove a page from the MRU list by physical address
+// Clear the user PTE at pte for uvmunmap(), and if it mapped a
+// tracked page take it out of the page's reverse map. Returns
+// the old PTE; the caller drops the page or swap slot reference
+// it held.
+pte_t
+mruunmap(pte_t *pte)
+{
+  acquire(&mru_list.lock);
+
+  pte_t old = *pte;
+  struct mru_entry *e;
+  if((old & PTE_V) && (e = *frameof(PTE2PA(old))) != 0)
+    mapdel(e, pte);
+  *pte = 0;
+
+  release(&mru_list.lock);
+  return old;
+}
+
+// For fork: make the child np's npte (at va) map what the
+// parent's pte does. A resident page is shared, and if writable
+// becomes copy-on-write for both; a swapped page shares the slot.
+// Returns 0, or -1 if the mapping could not be tracked.
+int
+mrushare(struct proc *np, uint64 va, pte_t *pte, pte_t *npte)
+{
+  acquire(&mru_list.lock);
+
+  if(*pte & PTE_V) {
+    uint64 pa = PTE2PA(*pte);
+    struct mru_entry *e = *frameof(pa);
+    if(e && mapadd(e, np, va, npte) < 0) {
+      release(&mru_list.lock);
+      return -1;
+    }
+    // the child's PTE starts clean, so if the parent has written
+    // the page since mruscan() last looked, the swap copy is stale
+    // and nothing would say so once the parent's mapping goes.
+    if(e && (*pte & PTE_D) && e->slot >= 0) {
+      swapfree(e->slot);
+      e->slot = -1;
+    }
+    if(*pte & PTE_W)
+      *pte = (*pte & ~PTE_W) | PTE_COW;
+    *npte = *pte & ~(PTE_A|PTE_D);
+    if(pa != (uint64)zeropage)
+      krefpage((void*)pa);
+  } else if(*pte & PTE_SWAPPED) {
+    swapdup(PTE2SLOT(*pte));
+    *npte = *pte;
+  }
+
+  release(&mru_list.lock);
+  return 0;
+}
+
+// A store to the copy-on-write page at pte (process p, address
+// va). If no one else maps the page any more, make it writable;
+// otherwise copy it into mem, a fresh page (already zeroed, if
+// pte maps the zero page), and map that instead.
+// Returns 0 if it was made writable, 1 if mem was used, and -1
+// if mem is needed but 0, or the PTE is no longer a resident
+// copy-on-write page (it was evicted meanwhile).
+int
+mrucow(struct proc *p, uint64 va, pte_t *pte, char *mem)
+{
+  acquire(&mru_list.lock);
+
+  if((*pte & (PTE_V|PTE_COW)) != (PTE_V|PTE_COW)) {
+    release(&mru_list.lock);
+    return -1;
+  }
+
+  uint64 pa = PTE2PA(*pte);
+  if(pa != (uint64)zeropage && krefcount((void*)pa) == 1) {
+    *pte = (*pte | PTE_W) & ~PTE_COW;
+    release(&mru_list.lock);
+    return 0;
+  }
+  if(mem == 0) {
+    release(&mru_list.lock);
+    return -1;
+  }
+
+  if(pa != (uint64)zeropage)
+    memmove(mem, (char*)pa, PGSIZE);
+
+  // the old page, and its swap copy, stay with the others.
+  struct mru_entry *e = *frameof(pa);
+  if(e)
+    mapdel(e, pte);
+
+  *pte = PA2PTE(mem) | ((PTE_FLAGS(*pte) | PTE_W) & ~PTE_COW);
+  // other harts p ran on may still map va to the old page.
+  tlbflush(p, va);
+  if((e = kmalloc(sizeof(struct mru_entry))) != 0) {
+    e->pa = (uint64)mem;
+    e->maps = 0;
+    e->slot = -1;
+    e->ahead = 0;
+    e->pin = 0;
+    if(mapadd(e, p, va, pte) < 0)
+      kmfree(e);
+    else
+      insert(e);
+  }
+  // the other mappings may have gone since the check above.
+  if(pa != (uint64)zeropage && kderef((void*)pa) == 0)
+    dec_user_pages();
+
+  release(&mru_list.lock);
+  return 1;
+}
+
+// A page read ahead of a fault has been used: count the hit.
+// Caller must hold mru_list.lock.
+static void
+aheadused(struct mru_entry *e)
+{
+  e->ahead->prefetch_hits++;
+  e->ahead = 0;
+}
+
+// Tell the policy that the page at pa was accessed
+void
+mruupdate(uint64 pa)
+{
+  acquire(&mru_list.lock);
+
+  struct mru_entry *e = *frameof(pa);
+  if(e) {
+    if(e->ahead)
+      aheadused(e);
+    mru_list.policy->touch(e);
+  }
+
+  release(&mru_list.lock);
+}
+
+// The kernel is about to use the user page that pte maps through
+// its physical address. If the PTE still maps it for user access,
+// pin the page so that mruevict() leaves it alone until
+// mruunpin(), and tell the policy about the access. write says
+// the kernel will store to it, which a copy-on-write page must
+// not get. The hardware doesn't see these accesses, so set PTE_A,
+// and PTE_D for a store, here.
+// Returns the physical address, or 0 if the PTE doesn't allow it.
+uint64
+mrupin(pte_t *pte, int write)
+{
+  uint64 pa = 0;
+
+  acquire(&mru_list.lock);
+
+  if((*pte & (PTE_V|PTE_U)) == (PTE_V|PTE_U) && !(write && (*pte & PTE_COW))) {
+    __sync_fetch_and_or(pte, write ? PTE_A | PTE_D : PTE_A);
+    pa = PTE2PA(*pte);
+    struct mru_entry *e = *frameof(pa);
+    if(e) {
+      e->pin++;
+      if(e->ahead)
+        aheadused(e);
+      mru_list.policy->touch(e);
+    }
+  }
+
+  release(&mru_list.lock);
+  return pa;
+}
+
+// The kernel is done with the page at pa, pinned by mrupin().
 void
-mruremove(uint64 pa)
+mruunpin(uint64 pa)
+{
+  acquire(&mru_list.lock);
+
+  struct mru_entry *e = *frameof(pa);
+  if(e && e->pin > 0)
+    e->pin--;
+
+  release(&mru_list.lock);
+}
+
+// Swap is full: free up to n of the slots kept as copies of
+// clean resident pages, starting with the most recently used.
+// Returns the number freed.
+// Caller must hold mru_list.lock.
+static int
+dropslots(int n)
+{
+  int dropped = 0;
+
+  for(int qi = 1; qi >= 0 && dropped < n; qi--) {
+    for(struct mru_entry *e = mru_list.q[qi].head; e && dropped < n; e = e->next) {
+      if(e->slot >= 0) {
+        swapfree(e->slot);
+        e->slot = -1;
+        dropped++;
+      }
+    }
+  }
+  return dropped;
+}
+
+// Evict up to n pages chosen by the policy, in one lock hold.
+// Every PTE in a victim's reverse map is switched to name its
+// swap slot: the copy it kept if no mapping has written the page
+// since (PTE_D), otherwise a new slot that the caller must write
+// the page to. The PTEs are made invalid and flushed before PTE_D
+// is looked at, so that no store can slip in after the decision. Each of those PTEs holds a slot reference, and
+// still a page reference for the caller to drop once the write
+// is done. The mapping processes' swap statistics are updated.
+// Pinned pages are set aside while the policy chooses, then put
+// back at the head of their queues, since they are in use.
+// Returns the number of victims, 0 if none.
+int
+mruevict(struct mru_victim *victims, int n)
 {
+  struct mru_entry *e, *held = 0;
+  int i;
+
   acquire(&mru_list.lock);
-  
-  struct mru_entry *e = mru_list.head;
-  while(e) {
-    if(e->pa == pa) {
-      if(e->prev)
-        e->prev->next = e->next;
-      else
-        mru_list.head = e->next;
-      
-      if(e->next)
-        e->next->prev = e->prev;
-      else
-        mru_list.tail = e->prev;
-      
+
+  for(i = 0; i < n; i++) {
+    while((e = mru_list.policy->victim()) != 0 && e->pin > 0) {
+      dequeue(e);
+      e->next = held;
+      held = e;
+    }
+    if(e == 0)
       break;
+
+    // the hardware may still set PTE_D until the PTE is invalid
+    // and gone from every TLB.
+    struct rmap *m, *next;
+    int wrote = 0;
+    for(m = e->maps; m; m = m->next) {
+      if(__sync_fetch_and_and(m->pte, ~PTE_V) & PTE_D)
+        wrote = 1;
+      tlbflush(m->proc, m->va);
+    }
+
+    int slot = e->slot;
+    victims[i].write = 0;
+    if(slot < 0 || wrote) {
+      slot = swapalloc();
+      if(slot < 0 && dropslots(EVICTBATCH) > 0)
+        slot = swapalloc();
+      if(slot < 0) {
+        printf("mruevict: no free swap space\n");
+        for(m = e->maps; m; m = m->next)
+          *m->pte |= PTE_V;
+        break;
+      }
+      // the old copy is stale.
+      if(e->slot >= 0 && e->slot != slot)
+        swapfree(e->slot);
+      victims[i].write = 1;
+      e->maps->proc->swap_writes++;
     }
-    e = e->next;
+    if(mru_list.policy->evict)
+      mru_list.policy->evict(e);
+
+    if(e->ahead) {
+      if(accessed(e, 0)) {
+        aheadused(e);
+      } else {
+        // read ahead for nothing: shrink the window. unlocked,
+        // but ra is only a hint.
+        e->ahead->ra /= 2;
+      }
+    }
+
+    victims[i].pid = e->maps->proc->pid;
+    victims[i].va = e->maps->va;
+    victims[i].pa = e->pa;
+    victims[i].slot = slot;
+    victims[i].nmap = 0;
+
+    for(m = e->maps; m; m = next) {
+      next = m->next;
+      *m->pte = SLOT2PTE(slot) | PTE_FLAGS(*m->pte) | PTE_SWAPPED;
+      // the slot reference we hold covers the first PTE.
+      if(victims[i].nmap++ > 0)
+        swapdup(slot);
+      m->proc->swap_outs++;
+      kmfree(m);
+    }
+    delete(e);
+    kmfree(e);
   }
-  
+
+  while((e = held) != 0) {
+    held = e->next;
+    enqueue(e, e->queue);
+  }
+
   release(&mru_list.lock);
+
+  return i;
 }
 
-// Update MRU position (move to head when accessed)
+// Look at every resident page. Harvest and clear PTE_A, reporting
+// referenced pages to the policy, note read-ahead pages that have
+// been used, and free the swap copy of any page that has been
+// written (PTE_D). There are only ever a few dozen resident user
+// pages (MAXUSERVMPAGES), so this is cheap.
+// Called on every clock tick, so recency follows user accesses
+// too. Aging is only approximate: clearing PTE_A is not followed
+// by a TLB flush, so a page used only through a cached
+// translation may look idle; that is the price of not shooting
+// down every page on every tick.
+// The PTE_D check here races with stores on other harts, so it
+// only frees stale copies early. Whether a kept copy is reused
+// is decided by mruevict() from PTE_D once the page is unmapped
+// and flushed, so a store this misses can't be lost.
 void
-mruupdate(int pid, uint64 va)
+mruscan(void)
 {
   acquire(&mru_list.lock);
-  
-  struct mru_entry *e = mru_list.head;
-  while(e) {
-    if(e->pid == pid && e->va == va) {
-      // Already at head
-      if(e == mru_list.head) {
-        release(&mru_list.lock);
-        return;
+
+  for(int qi = 0; qi < 2; qi++) {
+    struct mru_entry *e, *next;
+    for(e = mru_list.q[qi].head; e; e = next) {
+      // touch() only ever moves e to the head.
+      next = e->next;
+      if(e->slot >= 0 && dirty(e)) {
+        swapfree(e->slot);
+        e->slot = -1;
       }
-      
-      // Remove from current position
-      if(e->prev)
-        e->prev->next = e->next;
-      if(e->next)
-        e->next->prev = e->prev;
-      else
-        mru_list.tail = e->prev;
-      
-      // Move to head
-      e->next = mru_list.head;
-      e->prev = 0;
-      if(mru_list.head)
-        mru_list.head->prev = e;
-      mru_list.head = e;
-      
-      release(&mru_list.lock);
-      return;
+      int a = accessed(e, mru_list.policy->harvest);
+      if(a && e->ahead)
+        aheadused(e);
+      if(a && mru_list.policy->harvest)
+        mru_list.policy->touch(e);
     }
-    e = e->next;
   }
-  
+
   release(&mru_list.lock);
 }
 
-// Evict the MRU page (head of list)
-struct mru_entry*
-mruevict(void)
+// Switch to another replacement policy. Pages keep their order;
+// 2Q's second queue is folded into the first, ahead of it.
+// Returns the previous policy, or -1 if policy is not valid.
+int
+mrusetpolicy(int policy)
 {
+  if(policy < 0 || policy >= NPOLICY)
+    return -1;
+
   acquire(&mru_list.lock);
-  
-  struct mru_entry *victim = mru_list.head;
-  
-  if(victim == 0) {
-    release(&mru_list.lock);
-    return 0;
+
+  int old = mru_list.policy - policies;
+  struct mru_entry *e;
+  while((e = mru_list.q[1].tail) != 0) {
+    dequeue(e);
+    enqueue(e, 0);
   }
-  
-  // Remove from head
-  mru_list.head = victim->next;
-  if(mru_list.head)
-    mru_list.head->prev = 0;
-  else
-    mru_list.tail = 0;
-  
+  for(int i = 0; i < NGHOST; i++)
+    mru_list.ghost[i].pid = 0;
+  mru_list.policy = &policies[policy];
+
   release(&mru_list.lock);
-  
-  return victim;
+  return old;
 }
 
-// Dump MRU list to console
+// Dump the queues to console, head first, with each page's
+// mappings
 void
 mrudump(void)
 {
   acquire(&mru_list.lock);
-  
-  printf("MRU List (Most -> Least Recently Used):\n");
-  struct mru_entry *e = mru_list.head;
+
+  printf("%s policy, pages by queue (head -> tail):\n", policynames[mru_list.policy - policies]);
   int count = 0;
-  while(e) {
-    printf("  [%d] PID=%d VA=0x%lx PA=0x%lx\n", count++, e->pid, e->va, e->pa);
-    e = e->next;
+  for(int qi = 0; qi < 2; qi++) {
+    for(struct mru_entry *e = mru_list.q[qi].head; e; e = e->next) {
+      printf("  [%d] Q%d PA=0x%lx", count++, qi, e->pa);
+      for(struct rmap *m = e->maps; m; m = m->next)
+        printf(" PID=%d VA=0x%lx", m->proc->pid, m->va);
+      printf("\n");
+    }
   }
   if(count == 0)
     printf("  (empty)\n");
-  
+
   release(&mru_list.lock);
 }
 
-// Remove all entries for a process
+// p is going away: forget any mappings of its that are still
+// tracked (uvmfree() normally unmaps them all), and stop
+// counting read-ahead hits for it.
 void
-mrufree(int pid)
+mrufree(struct proc *p)
 {
   acquire(&mru_list.lock);
-  
-  struct mru_entry *e = mru_list.head;
-  while(e) {
-    struct mru_entry *next = e->next;
-    if(e->pid == pid) {
-      if(e->prev)
-        e->prev->next = e->next;
-      else
-        mru_list.head = e->next;
-      
-      if(e->next)
-        e->next->prev = e->prev;
-      else
-        mru_list.tail = e->prev;
+
+  for(int qi = 0; qi < 2; qi++) {
+    struct mru_entry *e = mru_list.q[qi].head;
+    while(e) {
+      struct mru_entry *next = e->next;
+      if(e->ahead == p)
+        e->ahead = 0;
+      struct rmap *m = e->maps, *mnext;
+      for(; m; m = mnext) {
+        mnext = m->next;
+        // may free e.
+        if(m->proc == p)
+          mapdel(e, m->pte);
+      }
+      e = next;
     }
-    e = next;
   }
-  
+
   release(&mru_list.lock);
 }
\ No newline at end of file
@@ -4,20 +4,50 @@
 
 #include "types.h"
 
-struct mru_entry {
-  int pid;
+struct proc;
+
+// One PTE that maps a tracked page: a reverse map entry.
+struct rmap {
+  struct proc *proc;         // whose page table pte is in
   uint64 va;
+  pte_t *pte;
+  struct rmap *next;
+};
+
+// A resident user page on the MRU list.
+struct mru_entry {
   uint64 pa;
+  struct rmap *maps;         // every PTE that maps the page
+  int queue;                 // which of mru_list.q[] it is on
+  int slot;                  // swap slot still holding a copy, or -1
+  struct proc *ahead;        // read ahead for this process, not yet used
+  int pin;                   // kernel users; mruevict() skips the page if > 0
   struct mru_entry *next;
   struct mru_entry *prev;
 };
 
+// A page taken by mruevict().
+struct mru_victim {
+  int pid;      // one of the processes that mapped it
+  uint64 va;    // ... and where
+  uint64 pa;
+  int slot;     // swap slot every mapping's PTE now names
+  int write;    // the page must still be written to slot
+  int nmap;     // mappings it had, each holding a page reference
+};
+
 void            mruinit(void);
-void            mruadd(int pid, uint64 va, uint64 pa);
-void            mruremove(uint64 pa);
-void            mruupdate(int pid, uint64 va);
-struct mru_entry* mruevict(void);
+int             mruadd(struct proc *p, uint64 va, uint64 pa, pte_t *pte, int slot, struct proc *ahead);
+pte_t           mruunmap(pte_t *pte);
+int             mrushare(struct proc *np, uint64 va, pte_t *pte, pte_t *npte);
+int             mrucow(struct proc *p, uint64 va, pte_t *pte, char *mem);
+void            mruupdate(uint64 pa);
+uint64          mrupin(pte_t *pte, int write);
+void            mruunpin(uint64 pa);
+int             mruevict(struct mru_victim *victims, int n);
+int             mrusetpolicy(int policy);
+void            mruscan(void);
 void            mrudump(void);
-void            mrufree(int pid);
+void            mrufree(struct proc *p);
 
 #endif
\ No newline at end of file
@@ -1,7 +1,6 @@
 #define NPROC        64  // maximum number of processes
 #define NCPU          8  // maximum number of CPUs
 #define NOFILE       16  // open files per process
-#define NFILE       100  // open files per system
 #define NINODE       50  // maximum number of active i-nodes
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
@@ -12,5 +11,16 @@
 #define FSSIZE       2000  // size of file system in blocks
 #define MAXPATH      128   // maximum file path name
 #define USERSTACK    1     // user stack pages
+#ifndef TICKHZ
+#define TICKHZ       10    // clock ticks per second
+#endif
+#define BOOSTTICKS   20    // ticks between raising every process to its base priority
+#define NWAITQ       61    // wait queues that sleep channels hash to
 
-#define MAXUSERVMPAGES  40  // Maximum user pages allowed in physical memory
\ No newline at end of file
+#define MAXUSERVMPAGES  40  // Maximum user pages allowed in physical memory
+#define SWAPSTART    FSSIZE  // first disk block of the swap area on ROOTDEV
+#define KSWAPD_LOW      4  // kswapd wakes when fewer user pages are free
+#define KSWAPD_HIGH     8  // ... and evicts until this many are free
+#define EVICTBATCH      8  // most pages evicted and written to swap at once
+#define NZEROPAGES     32  // pre-zeroed pages kzerod keeps for kalloc_zeroed()
+#define MAXREADAHEAD    8  // most pages brought in ahead of a sequential fault
\ No newline at end of file
@@ -0,0 +1,16 @@
+// page replacement policies, for setpolicy()
+#define POLICY_MRU    0  // evict the most recently used page
+#define POLICY_LRU    1  // evict the least recently used page
+#define POLICY_FIFO   2  // evict the page resident longest
+#define POLICY_CLOCK  3  // FIFO, but give pages with PTE_A a second chance
+#define POLICY_2Q     4  // FIFO for new pages, LRU for pages that come back
+#define NPOLICY       5
+
+// their names, for the kernel and user programs alike
+#define POLICYNAMES { \
+  [POLICY_MRU]   "MRU",   \
+  [POLICY_LRU]   "LRU",   \
+  [POLICY_FIFO]  "FIFO",  \
+  [POLICY_CLOCK] "CLOCK", \
+  [POLICY_2Q]    "2Q",    \
+}
@@ -4,6 +4,7 @@
 #include "riscv.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "sched.h"
 #include "defs.h"
 
 struct cpu cpus[NCPU];
@@ -12,6 +13,36 @@ struct proc proc[NPROC];
 
 struct proc *initproc;
 
+// Per-CPU run queues, one FIFO for each priority level. A
+// RUNNABLE process is on exactly one of them, at p->prio, from
+// when it becomes runnable until a scheduler() takes it off.
+// Take p->lock before a run queue lock.
+struct runq {
+  struct spinlock lock;
+  struct {
+    struct proc *head;
+    struct proc *tail;
+  } q[NPRIO];
+  int n;
+} runq[NCPU];
+
+// Sleeping processes, on wait queues hashed by sleep channel,
+// so that wakeup() need only look at those that might be on
+// its channel. Take a wait queue lock before p->lock.
+struct waitq {
+  struct spinlock lock;
+  struct proc *head;
+} waitq[NWAITQ];
+
+#define WAITQHASH(chan) (((uint64)(chan) >> 3) % NWAITQ)
+
+// The multilevel feedback queue: a process runs for
+// QUANTUM(prio) ticks before dropping a level. Every BOOSTTICKS
+// ticks, schedboost() bumps boostepoch and returns every process
+// to its base level, so none starves.
+#define QUANTUM(prio) (1 << (prio))
+int boostepoch;
+
 int nextpid = 1;
 struct spinlock pid_lock;
 
@@ -51,10 +82,15 @@ procinit(void)
   
   initlock(&pid_lock, "nextpid");
   initlock(&wait_lock, "wait_lock");
+  for(int i = 0; i < NCPU; i++)
+    initlock(&runq[i].lock, "runq");
+  for(int i = 0; i < NWAITQ; i++)
+    initlock(&waitq[i].lock, "waitq");
   for(p = proc; p < &proc[NPROC]; p++) {
       initlock(&p->lock, "proc");
       p->state = UNUSED;
       p->kstack = KSTACK((int) (p - proc));
+      p->asid = (int) (p - proc) + 1;  // the kernel uses ASID 0
   }
 }
 
@@ -124,12 +160,23 @@ allocproc(void)
 found:
   p->pid = allocpid();
   p->state = USED;
+  p->kfn = 0;
   p->page_faults = 0;
   p->swap_ins = 0;
   p->swap_outs = 0;
-  p->num_swapped = 0;
-  for(int i = 0; i < 64; i++)
-    p->swapped_pages[i] = -1;
+  p->swap_writes = 0;
+  p->prefetches = 0;
+  p->prefetch_hits = 0;
+  p->ra = 0;
+  p->lastfault = 0;
+  p->ranext = 0;
+  p->prio = p->base = 0;
+  p->epoch = boostepoch;
+  p->quantum = 0;
+  p->iowait = 0;
+  p->runticks = 0;
+  p->waitticks = 0;
+  p->nswitch = 0;
 
   // Allocate a trapframe page.
   if((p->trapframe = (struct trapframe *)kalloc()) == 0){
@@ -164,9 +211,12 @@ freeproc(struct proc *p)
   if(p->trapframe)
     kfree((void*)p->trapframe);
   p->trapframe = 0;
+  // the next process in this slot reuses the ASID.
+  tlbflushall(p);
   if(p->pagetable)
     proc_freepagetable(p->pagetable, p->sz);
   p->pagetable = 0;
+  mrufree(p);
   p->sz = 0;
   p->pid = 0;
   p->parent = 0;
@@ -175,8 +225,6 @@ freeproc(struct proc *p)
   p->killed = 0;
   p->xstate = 0;
   p->state = UNUSED;
-  swapfree(p->pid);
-  mrufree(p->pid);
 }
 
 // Create a user page table for a given process, with no user memory,
@@ -234,7 +282,7 @@ userinit(void)
   
   p->cwd = namei("/");
 
-  p->state = RUNNABLE;
+  setrunnable(p, cpuid());
 
   release(&p->lock);
 }
@@ -257,6 +305,7 @@ growproc(int n)
     }
   } else if(n < 0){
     sz = uvmdealloc(p->pagetable, sz, sz + n);
+    tlbflushall(p);
   }
   p->sz = sz;
   return 0;
@@ -277,13 +326,19 @@ kfork(void)
   }
 
   // Copy user memory from parent to child.
-  if(uvmcopy(p->pagetable, np->pagetable, p->sz) < 0){
+  // the parent's pages become read-only, copy-on-write.
+  int r = uvmcopy(p->pagetable, np->pagetable, p->sz, np);
+  tlbflushall(p);
+  if(r < 0){
     freeproc(np);
     release(&np->lock);
     return -1;
   }
   np->sz = p->sz;
 
+  // the child starts at the top of the parent's range.
+  np->prio = np->base = p->base;
+
   // copy saved user registers.
   *(np->trapframe) = *(p->trapframe);
 
@@ -307,12 +362,48 @@ kfork(void)
   release(&wait_lock);
 
   acquire(&np->lock);
-  np->state = RUNNABLE;
+  setrunnable(np, cpuid());
   release(&np->lock);
 
   return pid;
 }
 
+// A kernel thread's very first scheduling by scheduler()
+// will swtch to kthreadret.
+static void
+kthreadret(void)
+{
+  struct proc *p = myproc();
+
+  // Still holding p->lock from scheduler.
+  release(&p->lock);
+  intr_on();
+
+  p->kfn();
+  panic("kthread returned");
+}
+
+// Start a kernel thread running fn(). It gets a proc slot and a
+// kernel stack like any process, but never enters user space.
+// Returns its pid, or -1.
+int
+kthread(char *name, void (*fn)(void))
+{
+  struct proc *p;
+
+  if((p = allocproc()) == 0)
+    return -1;
+
+  p->kfn = fn;
+  p->context.ra = (uint64)kthreadret;
+  safestrcpy(p->name, name, sizeof(p->name));
+  setrunnable(p, cpuid());
+
+  int pid = p->pid;
+  release(&p->lock);
+  return pid;
+}
+
 // Pass p's abandoned children to init.
 // Caller must hold wait_lock.
 void
@@ -422,6 +513,206 @@ kwait(uint64 addr)
   }
 }
 
+// If there has been a boost since p's level was last set,
+// or setpriority() changed its base, return it to its base.
+static void
+refresh(struct proc *p)
+{
+  if(p->epoch != boostepoch){
+    p->epoch = boostepoch;
+    p->prio = p->base;
+    p->quantum = 0;
+  }
+}
+
+// Append p to level prio of rq. Caller must hold rq->lock.
+static void
+enqueue(struct runq *rq, struct proc *p, int prio)
+{
+  p->prio = prio;
+  p->rqnext = 0;
+  if(rq->q[prio].tail)
+    rq->q[prio].tail->rqnext = p;
+  else
+    rq->q[prio].head = p;
+  rq->q[prio].tail = p;
+}
+
+// An idle CPU sits in wfi, perhaps with its timer off, until
+// interrupted. Interrupt cpu if it is idle, now that there is
+// something on its run queue; or if it is busy elsewhere, some
+// idle CPU, which will steal it.
+static void
+kick(int cpu)
+{
+  if(cpus[cpu].idle){
+    ipi(cpu);
+    return;
+  }
+  if(cpu == cpuid())
+    return;
+  for(int i = 0; i < NCPU; i++){
+    if(cpus[i].idle){
+      ipi(i);
+      return;
+    }
+  }
+}
+
+// Make p RUNNABLE and put it at the tail of its level of
+// cpu's run queue. Caller must hold p->lock.
+void
+setrunnable(struct proc *p, int cpu)
+{
+  struct runq *rq = &runq[cpu];
+
+  refresh(p);
+  p->state = RUNNABLE;
+  p->readyat = timetick(r_time());
+  acquire(&rq->lock);
+  enqueue(rq, p, p->prio);
+  rq->n++;
+  release(&rq->lock);
+
+  kick(cpu);
+}
+
+// Take the process at the head of rq's highest non-empty
+// level, or return 0.
+static struct proc*
+dequeue(struct runq *rq)
+{
+  struct proc *p = 0;
+
+  acquire(&rq->lock);
+  for(int i = 0; i < NPRIO; i++){
+    if((p = rq->q[i].head) != 0){
+      rq->q[i].head = p->rqnext;
+      if(rq->q[i].head == 0)
+        rq->q[i].tail = 0;
+      rq->n--;
+      break;
+    }
+  }
+  release(&rq->lock);
+  return p;
+}
+
+// Return every queued process to its base level. Called by
+// clockintr() every BOOSTTICKS ticks; others pick up the new
+// boostepoch in refresh() when next made runnable or run.
+void
+schedboost(void)
+{
+  __sync_fetch_and_add(&boostepoch, 1);
+  for(struct runq *rq = runq; rq < &runq[NCPU]; rq++){
+    acquire(&rq->lock);
+    for(int i = 1; i < NPRIO; i++){
+      struct proc *p = rq->q[i].head, *next;
+      rq->q[i].head = rq->q[i].tail = 0;
+      for(; p; p = next){
+        next = p->rqnext;
+        p->epoch = boostepoch;
+        p->quantum = 0;
+        enqueue(rq, p, p->base);
+      }
+    }
+    release(&rq->lock);
+  }
+}
+
+// Charge a timer tick to the current process, and say whether
+// it should give up the CPU: because it has used up its quantum,
+// and so drops a level, or because something of higher priority
+// is waiting on this CPU.
+int
+schedtick(void)
+{
+  struct proc *p = myproc();
+  int preempt = 0;
+
+  acquire(&p->lock);
+  p->runticks++;
+  if(--p->quantum <= 0){
+    if(p->prio < NPRIO - 1)
+      p->prio++;
+    preempt = 1;
+  } else {
+    // unlocked peek; a miss only delays the switch a tick.
+    struct runq *rq = &runq[cpuid()];
+    for(int i = 0; i < p->prio; i++)
+      if(rq->q[i].head)
+        preempt = 1;
+  }
+  release(&p->lock);
+  return preempt;
+}
+
+// Set the base priority of process pid. It takes effect the
+// next time the process is made runnable or run.
+// Returns the old base, or -1.
+int
+setpriority(int pid, int prio)
+{
+  struct proc *p;
+
+  if(prio < 0 || prio >= NPRIO)
+    return -1;
+  for(p = proc; p < &proc[NPROC]; p++){
+    acquire(&p->lock);
+    if(p->pid == pid && p->state != UNUSED){
+      int old = p->base;
+      p->base = prio;
+      p->epoch = -1;
+      release(&p->lock);
+      return old;
+    }
+    release(&p->lock);
+  }
+  return -1;
+}
+
+// Copy out process pid's scheduling statistics.
+// Returns 0, or -1 if there is no such process.
+int
+getschedstat(int pid, struct schedstat *st)
+{
+  struct proc *p;
+
+  for(p = proc; p < &proc[NPROC]; p++){
+    acquire(&p->lock);
+    if(p->pid == pid && p->state != UNUSED){
+      st->prio = p->prio;
+      st->base = p->base;
+      st->runticks = p->runticks;
+      st->waitticks = p->waitticks;
+      st->nswitch = p->nswitch;
+      release(&p->lock);
+      return 0;
+    }
+    release(&p->lock);
+  }
+  return -1;
+}
+
+// Pick the next process for this CPU: the head of its own run
+// queue, or failing that one stolen from another CPU's.
+static struct proc*
+pickproc(int id)
+{
+  struct proc *p;
+
+  if((p = dequeue(&runq[id])) != 0)
+    return p;
+  for(int i = 1; i < NCPU; i++){
+    struct runq *rq = &runq[(id + i) % NCPU];
+    // n is only a hint, to skip empty queues without locking.
+    if(rq->n > 0 && (p = dequeue(rq)) != 0)
+      return p;
+  }
+  return 0;
+}
+
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
@@ -445,28 +736,48 @@ scheduler(void)
     intr_on();
     intr_off();
 
-    int found = 0;
-    for(p = proc; p < &proc[NPROC]; p++) {
-      acquire(&p->lock);
-      if(p->state == RUNNABLE) {
-        // Switch to chosen process.  It is the process's job
-        // to release its lock and then reacquire it
-        // before jumping back to us.
-        p->state = RUNNING;
-        c->proc = p;
-        swtch(&c->context, &p->context);
-
-        // Process is done running for now.
-        // It should have changed its p->state before coming back.
-        c->proc = 0;
-        found = 1;
+    if((p = pickproc(cpuid())) == 0) {
+      // say we are idle, so that setrunnable() will interrupt
+      // us, then look once more in case it just missed.
+      c->idle = 1;
+      __sync_synchronize();
+      if((p = pickproc(cpuid())) == 0) {
+        // nothing to run; stop running on this core until an
+        // interrupt, with the timer set only for a deadline.
+        w_stimecmp(nexttimer(0));
+        asm volatile("wfi");
+        c->idle = 0;
+        continue;
       }
-      release(&p->lock);
-    }
-    if(found == 0) {
-      // nothing to run; stop running on this core until an interrupt.
-      asm volatile("wfi");
+      c->idle = 0;
     }
+
+    // the timer may be off; p needs ticks.
+    w_stimecmp(nexttimer(1));
+
+    // p may still be switching out on the CPU that made it
+    // RUNNABLE; that CPU holds p->lock until it has.
+    acquire(&p->lock);
+    if(p->state != RUNNABLE)
+      panic("scheduler: not runnable");
+
+    // Switch to chosen process.  It is the process's job
+    // to release its lock and then reacquire it
+    // before jumping back to us.
+    p->state = RUNNING;
+    p->cpu = cpuid();
+    refresh(p);
+    if(p->quantum <= 0)
+      p->quantum = QUANTUM(p->prio);
+    p->waitticks += timetick(r_time()) - p->readyat;
+    p->nswitch++;
+    c->proc = p;
+    swtch(&c->context, &p->context);
+
+    // Process is done running for now.
+    // It should have changed its p->state before coming back.
+    c->proc = 0;
+    release(&p->lock);
   }
 }
 
@@ -503,7 +814,7 @@ yield(void)
 {
   struct proc *p = myproc();
   acquire(&p->lock);
-  p->state = RUNNABLE;
+  setrunnable(p, cpuid());
   sched();
   release(&p->lock);
 }
@@ -540,58 +851,102 @@ forkret(void)
 
   // return to user space, mimicing usertrap()'s return.
   prepare_return();
-  uint64 satp = MAKE_SATP(p->pagetable);
+  uint64 satp = MAKE_SATP(p->pagetable, p->asid);
   uint64 trampoline_userret = TRAMPOLINE + (userret - trampoline);
   ((void (*)(uint64))trampoline_userret)(satp);
 }
 
+// Take p off wait queue wq. Caller must hold wq->lock.
+static void
+wqremove(struct waitq *wq, struct proc *p)
+{
+  struct proc **pp;
+
+  for(pp = &wq->head; *pp; pp = &(*pp)->wqnext){
+    if(*pp == p){
+      *pp = p->wqnext;
+      break;
+    }
+  }
+  p->waitq = 0;
+}
+
 // Sleep on channel chan, releasing condition lock lk.
 // Re-acquires lk when awakened.
 void
 sleep(void *chan, struct spinlock *lk)
 {
   struct proc *p = myproc();
+  struct waitq *wq = &waitq[WAITQHASH(chan)];
   
   // Must acquire p->lock in order to
   // change p->state and then call sched.
-  // Once we hold p->lock, we can be
-  // guaranteed that we won't miss any wakeup
-  // (wakeup locks p->lock),
+  // Once we are on chan's wait queue as SLEEPING,
+  // we are guaranteed that we won't miss any wakeup
+  // (wakeup locks the queue, then p->lock),
   // so it's okay to release lk.
 
+  acquire(&wq->lock);
   acquire(&p->lock);  //DOC: sleeplock1
   release(lk);
 
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
+  p->waitq = wq;
+  p->wqnext = wq->head;
+  wq->head = p;
+  release(&wq->lock);
 
   sched();
 
   // Tidy up.
   p->chan = 0;
+  release(&p->lock);
+
+  // wakeup() takes p off the queue, but kkill() does not.
+  if(p->waitq){
+    acquire(&wq->lock);
+    if(p->waitq)
+      wqremove(wq, p);
+    release(&wq->lock);
+  }
 
   // Reacquire original lock.
-  release(&p->lock);
   acquire(lk);
 }
 
 // Wake up all processes sleeping on channel chan.
 // Caller should hold the condition lock.
+// Only chan's wait queue is searched.
 void
 wakeup(void *chan)
 {
-  struct proc *p;
-
-  for(p = proc; p < &proc[NPROC]; p++) {
-    if(p != myproc()){
-      acquire(&p->lock);
-      if(p->state == SLEEPING && p->chan == chan) {
-        p->state = RUNNABLE;
+  struct waitq *wq = &waitq[WAITQHASH(chan)];
+  struct proc *p, *next;
+
+  acquire(&wq->lock);
+  for(p = wq->head; p; p = next){
+    next = p->wqnext;
+    // p->chan may be changing, if p is on its way out of
+    // sleep(); check again under p->lock.
+    if(p->chan != chan)
+      continue;
+    acquire(&p->lock);
+    if(p->state == SLEEPING && p->chan == chan) {
+      wqremove(wq, p);
+      if(p->iowait){
+        // favour processes that wait for the disk: back to
+        // the top of their range, with a fresh quantum.
+        p->prio = p->base;
+        p->quantum = 0;
       }
-      release(&p->lock);
+      // back on the CPU whose cache it last warmed.
+      setrunnable(p, p->cpu);
     }
+    release(&p->lock);
   }
+  release(&wq->lock);
 }
 
 // Kill the process with the given pid.
@@ -608,7 +963,7 @@ kkill(int pid)
       p->killed = 1;
       if(p->state == SLEEPING){
         // Wake process from sleep().
-        p->state = RUNNABLE;
+        setrunnable(p, p->cpu);
       }
       release(&p->lock);
       return 0;
@@ -24,6 +24,8 @@ struct cpu {
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  int idle;                   // In wfi, with nothing to run
+  uint tick;                  // ticks at its last timer interrupt
 };
 
 extern struct cpu cpus[NCPU];
@@ -81,6 +83,8 @@ struct trapframe {
 
 enum procstate { UNUSED, USED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
+struct waitq;
+
 // Per-process state
 struct proc {
   struct spinlock lock;
@@ -88,9 +92,24 @@ struct proc {
   // p->lock must be held when using these:
   enum procstate state;        // Process state
   void *chan;                  // If non-zero, sleeping on chan
+  struct waitq *waitq;         // If non-zero, on this wait queue
+  struct proc *wqnext;         // Next on that wait queue
   int killed;                  // If non-zero, have been killed
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
+  int cpu;                     // Hart it last ran on
+  struct proc *rqnext;         // Next on its run queue, if RUNNABLE
+  int prio;                    // Scheduling level, 0 the highest
+  int base;                    // Level boosts return it to
+  int epoch;                   // boostepoch when prio was last reset
+  int quantum;                 // Ticks left at this level
+  int iowait;                  // Sleeping for the disk
+  uint64 wakeat;               // Sleeping until this time CSR value
+  int theap;                   // ... and where in the timer heap
+  uint64 readyat;              // ticks when it last became RUNNABLE
+  uint64 runticks;             // Scheduling statistics
+  uint64 waitticks;
+  uint64 nswitch;
 
   // wait_lock must be held when using this:
   struct proc *parent;         // Parent process
@@ -100,18 +119,26 @@ struct proc {
   uint64 sz;                   // Size of process memory (bytes)
   pagetable_t pagetable;       // User page table
   struct trapframe *trapframe; // data page for trampoline.S
+  int asid;                    // tags this process's TLB entries
+  uint64 tlbcpus;              // harts that may hold those entries
   struct context context;      // swtch() here to run process
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
+  void (*kfn)(void);           // if non-zero, a kernel thread running kfn
   // Page fault and swap statistics
   uint64 page_faults;
   uint64 swap_ins;
   uint64 swap_outs;
-  
-  // Swapped pages tracking
-  int swapped_pages[64];  // Map of swapped page indices
-  int num_swapped;
+  uint64 swap_writes;          // swap_outs that had to write the page
+  uint64 prefetches;           // pages brought in ahead of a fault
+  uint64 prefetch_hits;        // ... and then used
+
+  // Read-ahead: faults that move forward through memory bring
+  // in the next ra pages too.
+  int ra;
+  uint64 lastfault;            // page of the last fault
+  uint64 ranext;               // first page after its read-ahead
   
   struct inode *swapip;
 
@@ -121,4 +148,7 @@ struct pagestat {
   uint64 page_faults;
   uint64 swap_ins;
   uint64 swap_outs;
+  uint64 swap_writes;
+  uint64 prefetches;
+  uint64 prefetch_hits;
 };
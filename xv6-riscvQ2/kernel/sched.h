@@ -0,0 +1,11 @@
+// scheduling priorities and statistics, for setpriority()
+// and getschedstat()
+#define NPRIO  3  // priority levels; 0 is the highest
+
+struct schedstat {
+  int prio;          // current level
+  int base;          // level it returns to, set by setpriority()
+  uint64 runticks;   // ticks spent running
+  uint64 waitticks;  // ticks spent RUNNABLE, waiting for a CPU
+  uint64 nswitch;    // times it has been switched to
+};
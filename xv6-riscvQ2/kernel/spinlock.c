@@ -29,8 +29,11 @@ acquire(struct spinlock *lk)
   //   a5 = 1
   //   s1 = &lk->locked
   //   amoswap.w.aq a5, a5, (s1)
+  //
+  // interrupts are off, so flush for any TLB shootdown
+  // while waiting; the lock holder may be waiting for us.
   while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
-    ;
+    tlbpoll();
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
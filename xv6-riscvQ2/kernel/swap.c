@@ -6,114 +6,197 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "defs.h"
+#include "fs.h"
 #include "swap.h"
 
+// Swapped pages live on the root disk, in an area of SWAPBLOCKS
+// page-sized slots that starts just past the file system (see
+// SWAPSTART). In memory there is only a bitmap of used slots;
+// which slot holds a page is recorded in the page's own PTE
+// (PTE_SWAPPED, see riscv.h), so no operation has to scan the
+// swap area. After a fork several PTEs can name one slot, so
+// each slot also has a reference count.
 struct {
   struct spinlock lock;
-  struct swapslot slots[SWAPBLOCKS];
-  char data[SWAPBLOCKS][PGSIZE];  // Actually store the swapped data
+  short refs[SWAPBLOCKS];      // PTEs and kept copies naming the slot
+  uint64 used[SWAPBLOCKS/64];  // bit set: slot holds a page
+  uint64 busy[SWAPBLOCKS/64];  // bit set: slot is being written
+  uint64 dead[SWAPBLOCKS/64];  // bit set: free once the write is done
+  int hint;                    // next-fit: where to start looking
+  int nslots;                  // slots that fit on the disk
 } swaptable;
 
+#define TESTBIT(m, i) (((m)[(i)/64] >> ((i)%64)) & 1)
+#define SETBIT(m, i)  ((m)[(i)/64] |= (1UL << ((i)%64)))
+#define CLRBIT(m, i)  ((m)[(i)/64] &= ~(1UL << ((i)%64)))
+
 void
 swapinit(void)
 {
   initlock(&swaptable.lock, "swaptable");
+
+  uint64 cap = virtio_disk_capacity();
+  if(cap <= SWAPSTART)
+    swaptable.nslots = 0;
+  else if((cap - SWAPSTART) / SLOTBLOCKS < SWAPBLOCKS)
+    swaptable.nslots = (cap - SWAPSTART) / SLOTBLOCKS;
+  else
+    swaptable.nslots = SWAPBLOCKS;
+
+  // slots past the end of the disk are permanently in use.
   for(int i = 0; i < SWAPBLOCKS; i++) {
-    swaptable.slots[i].used = 0;
-    swaptable.slots[i].pid = 0;
-    swaptable.slots[i].va = 0;
+    if(i < swaptable.nslots)
+      CLRBIT(swaptable.used, i);
+    else
+      SETBIT(swaptable.used, i);
+    CLRBIT(swaptable.busy, i);
+    CLRBIT(swaptable.dead, i);
+    swaptable.refs[i] = 0;
   }
-  printf("swapinit: initialized %d swap blocks\n", SWAPBLOCKS);
+  swaptable.hint = 0;
+
+  printf("swapinit: %d swap slots at disk block %d\n", swaptable.nslots, SWAPSTART);
 }
 
-// Find a free swap slot and write page to it
-int
-swapout(int pid, uint64 va, char* page)
+// Claim a free slot, starting the search where the last one
+// was found. Returns -1 if swap is full.
+// Caller must hold swaptable.lock.
+static int
+slotalloc(void)
 {
-  acquire(&swaptable.lock);
-  
-  // Find free slot
-  int slot = -1;
-  for(int i = 0; i < SWAPBLOCKS; i++) {
-    if(swaptable.slots[i].used == 0) {
-      slot = i;
-      break;
+  int nwords = SWAPBLOCKS/64;
+
+  for(int n = 0; n < nwords; n++) {
+    int w = (swaptable.hint/64 + n) % nwords;
+    if(swaptable.used[w] == ~0UL)
+      continue;
+    for(int b = 0; b < 64; b++) {
+      if((swaptable.used[w] & (1UL << b)) == 0) {
+        int slot = w*64 + b;
+        SETBIT(swaptable.used, slot);
+        swaptable.refs[slot] = 1;
+        swaptable.hint = slot + 1;
+        return slot;
+      }
     }
   }
-  
-  if(slot < 0) {
-    release(&swaptable.lock);
-    printf("swapout: no free swap space\n");
-    return -1;
-  }
-  
-  // Mark slot as used and copy data
-  swaptable.slots[slot].used = 1;
-  swaptable.slots[slot].pid = pid;
-  swaptable.slots[slot].va = va;
-  memmove(swaptable.data[slot], page, PGSIZE);
-  
+  return -1;
+}
+
+// Caller must hold swaptable.lock.
+static void
+slotfree(int slot)
+{
+  CLRBIT(swaptable.used, slot);
+}
+
+// Reserve a swap slot, with one reference. The slot stays busy
+// until swapwritev() has put the page on disk; a swapin() of it
+// meanwhile waits.
+// Returns the slot, or -1 if there is no swap space left.
+int
+swapalloc(void)
+{
+  acquire(&swaptable.lock);
+
+  int slot = slotalloc();
+  if(slot >= 0)
+    SETBIT(swaptable.busy, slot);
+
   release(&swaptable.lock);
-  
-  printf("swapout: PID=%d VA=0x%lx -> slot %d\n", pid, va, slot);
-  
   return slot;
 }
 
-// Read page from swap slot
-int
-swapin(int pid, uint64 va, char* page)
+// Write n pages to their slots from swapalloc(), all in one
+// burst of disk requests.
+void
+swapwritev(int *slots, char **pages, int n)
 {
+  uint blocknos[EVICTBATCH];
+
+  if(n > EVICTBATCH)
+    panic("swapwritev");
+  for(int i = 0; i < n; i++)
+    blocknos[i] = SLOT2BLOCK(slots[i]);
+  virtio_disk_rwpages(blocknos, pages, n, 1);
+
   acquire(&swaptable.lock);
-  
-  // Find the swap slot
-  int slot = -1;
-  for(int i = 0; i < SWAPBLOCKS; i++) {
-    if(swaptable.slots[i].used && 
-       swaptable.slots[i].pid == pid && 
-       swaptable.slots[i].va == va) {
-      slot = i;
-      break;
+  for(int i = 0; i < n; i++) {
+    int slot = slots[i];
+    CLRBIT(swaptable.busy, slot);
+    if(TESTBIT(swaptable.dead, slot)) {
+      CLRBIT(swaptable.dead, slot);
+      slotfree(slot);
     }
+    wakeup(&swaptable.busy[slot/64]);
   }
-  
-  if(slot < 0) {
-    release(&swaptable.lock);
-    printf("swapin: not found PID=%d VA=0x%lx\n", pid, va);
-    return -1;
-  }
-  
-  // Copy data back and free the swap slot
-  memmove(page, swaptable.data[slot], PGSIZE);
-  swaptable.slots[slot].used = 0;
-  swaptable.slots[slot].pid = 0;
-  swaptable.slots[slot].va = 0;
-  
   release(&swaptable.lock);
-  
-  printf("swapin: PID=%d VA=0x%lx from slot %d\n", pid, va, slot);
-  
+}
+
+// Wait for any write to slot to finish.
+static void
+slotwait(int slot)
+{
+  acquire(&swaptable.lock);
+  while(TESTBIT(swaptable.busy, slot))
+    sleep(&swaptable.busy[slot/64], &swaptable.lock);
+  release(&swaptable.lock);
+}
+
+// Read a page back from swap. The slot stays allocated, so
+// that the copy can be reused if the page is evicted again
+// unmodified; the caller frees it with swapfree().
+int
+swapin(int slot, char* page)
+{
+  return swapinv(&slot, &page, 1);
+}
+
+// Read n pages back from their slots in one burst of disk
+// requests. Like swapin(), leaves the slots allocated.
+int
+swapinv(int *slots, char **pages, int n)
+{
+  uint blocknos[MAXREADAHEAD+1];
+
+  if(n > MAXREADAHEAD+1)
+    panic("swapinv");
+  for(int i = 0; i < n; i++) {
+    if(slots[i] < 0 || slots[i] >= swaptable.nslots)
+      panic("swapin: bad slot");
+    slotwait(slots[i]);
+    blocknos[i] = SLOT2BLOCK(slots[i]);
+  }
+  virtio_disk_rwpages(blocknos, pages, n, 0);
+
   return 0;
 }
 
-// Free all swap slots for a process
+// Take another reference to a slot, for another PTE naming it.
 void
-swapfree(int pid)
+swapdup(int slot)
 {
   acquire(&swaptable.lock);
-  
-  int count = 0;
-  for(int i = 0; i < SWAPBLOCKS; i++) {
-    if(swaptable.slots[i].used && swaptable.slots[i].pid == pid) {
-      swaptable.slots[i].used = 0;
-      swaptable.slots[i].pid = 0;
-      swaptable.slots[i].va = 0;
-      count++;
-    }
+  if(swaptable.refs[slot] <= 0)
+    panic("swapdup");
+  swaptable.refs[slot]++;
+  release(&swaptable.lock);
+}
+
+// Drop a reference to a swap slot, freeing it with the last one.
+// If the page is still being written, the slot is freed when
+// that finishes.
+void
+swapfree(int slot)
+{
+  acquire(&swaptable.lock);
+  if(swaptable.refs[slot] <= 0)
+    panic("swapfree");
+  if(--swaptable.refs[slot] == 0) {
+    if(TESTBIT(swaptable.busy, slot))
+      SETBIT(swaptable.dead, slot);
+    else
+      slotfree(slot);
   }
-  
   release(&swaptable.lock);
-  
-  if(count > 0)
-    printf("swapfree: freed %d slots for PID=%d\n", count, pid);
 }
\ No newline at end of file
@@ -5,18 +5,19 @@
 #include "types.h"
 #include "param.h"
 
-#define SWAPBLOCKS 1024  // Number of swap blocks
+#define SWAPBLOCKS 1024  // Number of swap slots, one page each
 #define SWAPSIZE (SWAPBLOCKS * PGSIZE)
+#define SLOTBLOCKS (PGSIZE / BSIZE)  // disk blocks per swap slot
 
-struct swapslot {
-  int used;
-  int pid;
-  uint64 va;  // Virtual address of the swapped page
-};
+// Slot s occupies disk blocks SWAPSTART + s*SLOTBLOCKS onwards.
+#define SLOT2BLOCK(s) (SWAPSTART + (s) * SLOTBLOCKS)
 
 void            swapinit(void);
-int             swapout(int pid, uint64 va, char* page);
-int             swapin(int pid, uint64 va, char* page);
-void            swapfree(int pid);
+int             swapalloc(void);
+void            swapwritev(int *slots, char **pages, int n);
+int             swapin(int slot, char* page);
+int             swapinv(int *slots, char **pages, int n);
+void            swapdup(int slot);
+void            swapfree(int slot);
 
 #endif
\ No newline at end of file
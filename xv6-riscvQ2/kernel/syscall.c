@@ -103,6 +103,11 @@ extern uint64 sys_mkdir(void);
 extern uint64 sys_close(void);
 extern uint64 sys_getpagestat(void);
 extern uint64 sys_dumpmru(void);
+extern uint64 sys_setpolicy(void);
+extern uint64 sys_memstat(void);
+extern uint64 sys_setpriority(void);
+extern uint64 sys_getschedstat(void);
+extern uint64 sys_usleep(void);
 
 // An array mapping syscall numbers from syscall.h
 // to the function that handles the system call.
@@ -130,6 +135,11 @@ static uint64 (*syscalls[])(void) = {
 [SYS_close]   sys_close,
 [SYS_getpagestat] sys_getpagestat,
 [SYS_dumpmru]     sys_dumpmru,
+[SYS_setpolicy]   sys_setpolicy,
+[SYS_memstat]     sys_memstat,
+[SYS_setpriority] sys_setpriority,
+[SYS_getschedstat] sys_getschedstat,
+[SYS_usleep]      sys_usleep,
 };
 
 void
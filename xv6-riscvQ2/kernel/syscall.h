@@ -21,4 +21,9 @@
 #define SYS_mkdir  20
 #define SYS_close  21
 #define SYS_getpagestat 22
-#define SYS_dumpmru     23
\ No newline at end of file
+#define SYS_dumpmru     23
+#define SYS_setpolicy   24
+#define SYS_memstat     25
+#define SYS_setpriority 26
+#define SYS_getschedstat 27
+#define SYS_usleep      28
\ No newline at end of file
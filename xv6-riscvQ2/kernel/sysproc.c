@@ -7,6 +7,8 @@
 #include "proc.h"
 #include "vm.h"
 #include "mru.h"
+#include "memstat.h"
+#include "sched.h"
 
 extern struct proc proc[NPROC];
 
@@ -36,6 +38,9 @@ sys_getpagestat(void)
   st.page_faults = p->page_faults;
   st.swap_ins = p->swap_ins;
   st.swap_outs = p->swap_outs;
+  st.swap_writes = p->swap_writes;
+  st.prefetches = p->prefetches;
+  st.prefetch_hits = p->prefetch_hits;
   
   if(copyout(myproc()->pagetable, st_addr, (char*)&st, sizeof(st)) < 0)
     return -1;
@@ -50,6 +55,54 @@ sys_dumpmru(void)
   return 0;
 }
 
+uint64
+sys_setpolicy(void)
+{
+  int policy;
+
+  argint(0, &policy);
+  return mrusetpolicy(policy);
+}
+
+uint64
+sys_memstat(void)
+{
+  uint64 st_addr;
+  struct memstat st;
+
+  argaddr(0, &st_addr);
+  kmemstat(&st);
+  if(copyout(myproc()->pagetable, st_addr, (char*)&st, sizeof(st)) < 0)
+    return -1;
+  return 0;
+}
+
+uint64
+sys_setpriority(void)
+{
+  int pid, prio;
+
+  argint(0, &pid);
+  argint(1, &prio);
+  return setpriority(pid, prio);
+}
+
+uint64
+sys_getschedstat(void)
+{
+  int pid;
+  uint64 st_addr;
+  struct schedstat st;
+
+  argint(0, &pid);
+  argaddr(1, &st_addr);
+  if(getschedstat(pid, &st) < 0)
+    return -1;
+  if(copyout(myproc()->pagetable, st_addr, (char*)&st, sizeof(st)) < 0)
+    return -1;
+  return 0;
+}
+
 
 uint64
 sys_exit(void)
@@ -112,22 +165,20 @@ uint64
 sys_pause(void)
 {
   int n;
-  uint ticks0;
 
   argint(0, &n);
   if(n < 0)
     n = 0;
-  acquire(&tickslock);
-  ticks0 = ticks;
-  while(ticks - ticks0 < n){
-    if(killed(myproc())){
-      release(&tickslock);
-      return -1;
-    }
-    sleep(&ticks, &tickslock);
-  }
-  release(&tickslock);
-  return 0;
+  return kpause(n);
+}
+
+uint64
+sys_usleep(void)
+{
+  uint64 us;
+
+  argaddr(0, &us);
+  return kusleep(us);
 }
 
 uint64
@@ -139,15 +190,11 @@ sys_kill(void)
   return kkill(pid);
 }
 
-// return how many clock tick interrupts have occurred
-// since start.
+// return how many clock ticks have passed since start.
+// ticks itself lags while every hart is idle, so ask the
+// time CSR.
 uint64
 sys_uptime(void)
 {
-  uint xticks;
-
-  acquire(&tickslock);
-  xticks = ticks;
-  release(&tickslock);
-  return xticks;
+  return (uint)timetick(r_time());
 }
@@ -0,0 +1,174 @@
+// Timer deadlines.
+//
+// A hart programs its timer (stimecmp) only for something that
+// needs it: the next tick while it runs a process, and the
+// earliest deadline of a process in pause() or usleep(). An idle
+// hart with neither sleeps in wfi until a device or another hart
+// interrupts it.
+//
+// Sleeping processes are kept in a min-heap by deadline, so a
+// timer interrupt wakes only those whose deadlines have passed.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+#define TICKCYCLES (TIMEBASE / TICKHZ)
+#define USCYCLES   (TIMEBASE / 1000000)
+
+struct {
+  struct spinlock lock;
+  struct proc *heap[NPROC];  // sleepers; heap[0] has the soonest p->wakeat
+  int n;
+} timers;
+
+uint64 tickbase;      // time CSR value at tick 0
+
+void
+tickinit(void)
+{
+  initlock(&timers.lock, "timers");
+  tickbase = r_time();
+}
+
+// Put heap[i] at i, and record where it is.
+static void
+place(int i, struct proc *p)
+{
+  timers.heap[i] = p;
+  p->theap = i;
+}
+
+// Move p up from i to where it belongs.
+static void
+siftup(int i, struct proc *p)
+{
+  while(i > 0){
+    struct proc *parent = timers.heap[(i - 1) / 2];
+    if(parent->wakeat <= p->wakeat)
+      break;
+    place(i, parent);
+    i = (i - 1) / 2;
+  }
+  place(i, p);
+}
+
+// Move p down from i to where it belongs.
+static void
+siftdown(int i, struct proc *p)
+{
+  for(;;){
+    int c = 2*i + 1;
+    if(c >= timers.n)
+      break;
+    if(c + 1 < timers.n && timers.heap[c+1]->wakeat < timers.heap[c]->wakeat)
+      c++;
+    if(p->wakeat <= timers.heap[c]->wakeat)
+      break;
+    place(i, timers.heap[c]);
+    i = c;
+  }
+  place(i, p);
+}
+
+// Take p out of the heap. Caller must hold timers.lock.
+static void
+timerremove(struct proc *p)
+{
+  int i = p->theap;
+  struct proc *last = timers.heap[--timers.n];
+
+  if(last != p){
+    if(i > 0 && timers.heap[(i - 1) / 2]->wakeat > last->wakeat)
+      siftup(i, last);
+    else
+      siftdown(i, last);
+  }
+  p->wakeat = 0;
+}
+
+// Sleep until the time CSR reaches t.
+// Returns 0, or -1 if killed.
+static int
+sleepuntil(uint64 t)
+{
+  struct proc *p = myproc();
+
+  if(t <= r_time())
+    return 0;
+
+  acquire(&timers.lock);
+  p->wakeat = t;
+  siftup(timers.n++, p);
+
+  // timerexpire() clears wakeat.
+  while(p->wakeat){
+    if(killed(p)){
+      timerremove(p);
+      release(&timers.lock);
+      return -1;
+    }
+    sleep(&p->wakeat, &timers.lock);
+  }
+  release(&timers.lock);
+  return 0;
+}
+
+// Sleep for n ticks. Returns 0, or -1 if killed.
+int
+kpause(int n)
+{
+  return sleepuntil(tickbase + (timetick(r_time()) + n) * TICKCYCLES);
+}
+
+// Sleep for us microseconds, to within a timer interrupt's
+// latency rather than a tick. Returns 0, or -1 if killed.
+int
+kusleep(uint64 us)
+{
+  return sleepuntil(r_time() + us * USCYCLES);
+}
+
+// Wake the processes whose deadlines have passed.
+// Called on every timer interrupt.
+void
+timerexpire(void)
+{
+  uint64 now = r_time();
+  struct proc *p;
+
+  acquire(&timers.lock);
+  while(timers.n > 0 && (p = timers.heap[0])->wakeat <= now){
+    timerremove(p);
+    wakeup(&p->wakeat);
+  }
+  release(&timers.lock);
+}
+
+// The tick that the time CSR value t falls in.
+uint64
+timetick(uint64 t)
+{
+  return (t - tickbase) / TICKCYCLES;
+}
+
+// When should this hart's next timer interrupt be? busy says
+// whether it is running a process, which needs ticks.
+// Returns a time CSR value, or -1 for never.
+uint64
+nexttimer(int busy)
+{
+  uint64 next = -1;
+
+  if(busy)
+    next = tickbase + (timetick(r_time()) + 1) * TICKCYCLES;
+  acquire(&timers.lock);
+  if(timers.n > 0 && timers.heap[0]->wakeat < next)
+    next = timers.heap[0]->wakeat;
+  release(&timers.lock);
+  return next;
+}
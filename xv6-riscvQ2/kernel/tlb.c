@@ -0,0 +1,103 @@
+// TLB shootdown.
+//
+// Each process has its own ASID, so its TLB entries survive
+// switches to the kernel and to other processes. When the kernel
+// changes or removes one of a process's PTEs it must flush the
+// stale entry from every hart the process has run on since its
+// ASID was last flushed everywhere: p->tlbcpus. This hart flushes
+// its own TLB; the others get an inter-processor interrupt.
+//
+// There is one shootdown at a time. A hart spinning with
+// interrupts off would never see the IPI, so acquire() and
+// shoot() poll for pending requests while they wait.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+
+#define ALLPAGES ((uint64)-1)
+
+struct {
+  int locked;               // a shootdown is in progress
+  int asid;
+  uint64 va;                // or ALLPAGES
+  volatile uint64 pending;  // harts that have yet to flush
+} shootdown;
+
+// Do this hart's part of any shootdown in progress.
+// Interrupts must be disabled.
+void
+tlbpoll(void)
+{
+  uint64 bit = 1L << cpuid();
+
+  if((shootdown.pending & bit) == 0)
+    return;
+  __sync_synchronize();
+  if(shootdown.va == ALLPAGES)
+    sfence_vma_asid(shootdown.asid);
+  else
+    sfence_vma_page(shootdown.va, shootdown.asid);
+  __sync_fetch_and_and(&shootdown.pending, ~bit);
+}
+
+// Ask the harts in mask to flush va (or all) of asid,
+// and wait until they have.
+static void
+shoot(uint64 mask, int asid, uint64 va)
+{
+  while(__sync_lock_test_and_set(&shootdown.locked, 1) != 0)
+    tlbpoll();
+  shootdown.asid = asid;
+  shootdown.va = va;
+  __sync_synchronize();
+  shootdown.pending = mask;
+  __sync_synchronize();
+
+  for(int i = 0; i < NCPU; i++)
+    if(mask & (1L << i))
+      ipi(i);
+
+  while(shootdown.pending)
+    tlbpoll();
+
+  __sync_lock_release(&shootdown.locked);
+}
+
+// The PTE for va in p's page table has changed;
+// flush it from every TLB that may hold it.
+void
+tlbflush(struct proc *p, uint64 va)
+{
+  push_off();
+  // order the PTE store before the read of tlbcpus.
+  __sync_synchronize();
+  uint64 me = 1L << cpuid();
+  uint64 mask = p->tlbcpus;
+  if(mask & me)
+    sfence_vma_page(va, p->asid);
+  if(mask & ~me)
+    shoot(mask & ~me, p->asid, va);
+  pop_off();
+}
+
+// Flush all of p's TLB entries everywhere, after
+// many PTEs changed or the page table was replaced.
+// p must not be running on another hart, since that
+// hart would refill its TLB without being in p->tlbcpus.
+void
+tlbflushall(struct proc *p)
+{
+  push_off();
+  uint64 me = 1L << cpuid();
+  uint64 mask = __sync_fetch_and_and(&p->tlbcpus, 0);
+  if(mask & me)
+    sfence_vma_asid(p->asid);
+  if(mask & ~me)
+    shoot(mask & ~me, p->asid, ALLPAGES);
+  pop_off();
+}
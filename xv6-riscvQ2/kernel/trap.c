@@ -71,10 +71,14 @@ usertrap(void)
   } else if((r_scause() == 15 || r_scause() == 13)) {
     // Page fault (load or store)
     uint64 va = r_stval();
+    int write = r_scause() == 15;
+
+    // swapping the page in may wait for the disk.
+    intr_on();
     
-    if(handle_page_fault(va) < 0) {
+    if(handle_page_fault(va, write) < 0) {
       printf("usertrap(): unexpected page fault va=0x%lx pid=%d\n", va, p->pid);
-      printf("            sepc=0x%lx stval=0x%lx\n", r_sepc(), r_stval());
+      printf("            sepc=0x%lx stval=0x%lx\n", p->trapframe->epc, va);
       setkilled(p);
     }
 
@@ -87,14 +91,14 @@ usertrap(void)
   if(killed(p))
     kexit(-1);
 
-  // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2)
+  // give up the CPU if this timer interrupt ends its quantum.
+  if(which_dev == 2 && schedtick())
     yield();
 
   prepare_return();
 
   // the user page table to switch to, for trampoline.S
-  uint64 satp = MAKE_SATP(p->pagetable);
+  uint64 satp = MAKE_SATP(p->pagetable, p->asid);
 
   // return to trampoline.S; satp value in a0.
   return satp;
@@ -124,6 +128,9 @@ prepare_return(void)
   p->trapframe->kernel_trap = (uint64)usertrap;
   p->trapframe->kernel_hartid = r_tp();         // hartid for cpuid()
 
+  // this hart's TLB is about to hold entries for p's ASID.
+  __sync_fetch_and_or(&p->tlbcpus, 1L << cpuid());
+
   // set up the registers that trampoline.S's sret will use
   // to get to user space.
   
@@ -158,8 +165,8 @@ kerneltrap()
     panic("kerneltrap");
   }
 
-  // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2 && myproc() != 0)
+  // give up the CPU if this timer interrupt ends its quantum.
+  if(which_dev == 2 && myproc() != 0 && schedtick())
     yield();
 
   // the yield() may have caused some traps to occur,
@@ -168,20 +175,45 @@ kerneltrap()
   w_sstatus(sstatus);
 }
 
-void
+// a timer interrupt. returns 1 if a tick has passed since
+// this hart's last one, 0 if it came early for a deadline.
+int
 clockintr()
 {
-  if(cpuid() == 0){
+  struct cpu *c = mycpu();
+  uint now = timetick(r_time());
+  uint old = 0;
+  int advanced = 0;
+
+  // ticks follows the time CSR, so whichever hart is
+  // interrupted first after a tick boundary moves it on.
+  if(now != ticks){
     acquire(&tickslock);
-    ticks++;
-    wakeup(&ticks);
+    if((int)(now - ticks) > 0){
+      old = ticks;
+      ticks = now;
+      advanced = 1;
+    }
     release(&tickslock);
   }
+  if(advanced){
+    if(now / BOOSTTICKS != old / BOOSTTICKS)
+      schedboost();
+
+    // feed user accesses (PTE_A) to the page replacement policy.
+    mruscan();
+  }
+
+  timerexpire();
 
   // ask for the next timer interrupt. this also clears
-  // the interrupt request. 1000000 is about a tenth
-  // of a second.
-  w_stimecmp(r_time() + 1000000);
+  // the interrupt request.
+  w_stimecmp(nexttimer(c->proc != 0));
+
+  // is this a new tick for the process running here?
+  int tick = c->tick != now;
+  c->tick = now;
+  return tick;
 }
 
 // check if it's an external interrupt or software interrupt,
@@ -216,11 +248,27 @@ devintr()
 
     return 1;
   } else if(scause == 0x8000000000000005L){
-    // timer interrupt.
-    clockintr();
-    return 2;
+    // timer interrupt. it may be for a sleep deadline
+    // rather than a tick.
+    if(clockintr())
+      return 2;
+    return 1;
+  } else if(scause == 0x8000000000000001L){
+    // software interrupt, forwarded by ipivec in kernelvec.S:
+    // another hart wants a TLB shootdown, or has given this
+    // idle one something to run.
+    w_sip(r_sip() & ~2);
+    tlbpoll();
+    return 1;
   } else {
     return 0;
   }
 }
 
+// Interrupt hart with a machine-mode software interrupt, which
+// ipivec in kernelvec.S passes on as a supervisor one.
+void
+ipi(int hart)
+{
+  *(volatile uint32*)CLINT_MSIP(hart) = 1;
+}
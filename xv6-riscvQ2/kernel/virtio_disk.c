@@ -11,6 +11,7 @@
 #include "param.h"
 #include "memlayout.h"
 #include "spinlock.h"
+#include "proc.h"
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
@@ -47,6 +48,7 @@ static struct disk {
   // indexed by first descriptor index of chain.
   struct {
     struct buf *b;
+    int *npending; // if b is 0: virtio_disk_rwpages() count to decrement
     char status;
   } info[NUM];
 
@@ -152,6 +154,15 @@ virtio_disk_init(void)
   // plic.c and trap.c arrange for interrupts from VIRTIO0_IRQ.
 }
 
+// size of the disk in BSIZE blocks, from the device's config space.
+uint64
+virtio_disk_capacity(void)
+{
+  // capacity is a 64-bit count of 512-byte sectors.
+  uint64 sectors = *R(VIRTIO_MMIO_CONFIG) | ((uint64)*R(VIRTIO_MMIO_CONFIG + 4) << 32);
+  return sectors / (BSIZE / 512);
+}
+
 // find a free descriptor, mark it non-free, return its index.
 static int
 alloc_desc()
@@ -212,27 +223,16 @@ alloc3_desc(int *idx)
   return 0;
 }
 
-void
-virtio_disk_rw(struct buf *b, int write)
+// format the three descriptors in idx for a transfer of len
+// bytes at addr to or from the disk starting at sector, and
+// put the chain on the avail ring. the caller notifies the device.
+static void
+submit(int *idx, uint64 sector, uint64 addr, uint32 len, int write)
 {
-  uint64 sector = b->blockno * (BSIZE / 512);
-
-  acquire(&disk.vdisk_lock);
-
   // the spec's Section 5.2 says that legacy block operations use
   // three descriptors: one for type/reserved/sector, one for the
   // data, one for a 1-byte status result.
 
-  // allocate the three descriptors.
-  int idx[3];
-  while(1){
-    if(alloc3_desc(idx) == 0) {
-      break;
-    }
-    sleep(&disk.free[0], &disk.vdisk_lock);
-  }
-
-  // format the three descriptors.
   // qemu's virtio-blk.c reads them.
 
   struct virtio_blk_req *buf0 = &disk.ops[idx[0]];
@@ -249,12 +249,12 @@ virtio_disk_rw(struct buf *b, int write)
   disk.desc[idx[0]].flags = VRING_DESC_F_NEXT;
   disk.desc[idx[0]].next = idx[1];
 
-  disk.desc[idx[1]].addr = (uint64) b->data;
-  disk.desc[idx[1]].len = BSIZE;
+  disk.desc[idx[1]].addr = addr;
+  disk.desc[idx[1]].len = len;
   if(write)
-    disk.desc[idx[1]].flags = 0; // device reads b->data
+    disk.desc[idx[1]].flags = 0; // device reads the data
   else
-    disk.desc[idx[1]].flags = VRING_DESC_F_WRITE; // device writes b->data
+    disk.desc[idx[1]].flags = VRING_DESC_F_WRITE; // device writes the data
   disk.desc[idx[1]].flags |= VRING_DESC_F_NEXT;
   disk.desc[idx[1]].next = idx[2];
 
@@ -264,10 +264,6 @@ virtio_disk_rw(struct buf *b, int write)
   disk.desc[idx[2]].flags = VRING_DESC_F_WRITE; // device writes the status
   disk.desc[idx[2]].next = 0;
 
-  // record struct buf for virtio_disk_intr().
-  b->disk = 1;
-  disk.info[idx[0]].b = b;
-
   // tell the device the first index in our chain of descriptors.
   disk.avail->ring[disk.avail->idx % NUM] = idx[0];
 
@@ -275,15 +271,53 @@ virtio_disk_rw(struct buf *b, int write)
 
   // tell the device another avail ring entry is available.
   disk.avail->idx += 1; // not % NUM ...
+}
+
+// mark the current process as waiting for the disk, or not.
+// wakeup() reads iowait under p->lock, and favours such
+// processes.
+static void
+iowait(int on)
+{
+  struct proc *p = myproc();
+
+  acquire(&p->lock);
+  p->iowait = on;
+  release(&p->lock);
+}
+
+void
+virtio_disk_rw(struct buf *b, int write)
+{
+  uint64 sector = b->blockno * (BSIZE / 512);
+
+  acquire(&disk.vdisk_lock);
+
+  // allocate the three descriptors.
+  int idx[3];
+  while(1){
+    if(alloc3_desc(idx) == 0) {
+      break;
+    }
+    sleep(&disk.free[0], &disk.vdisk_lock);
+  }
+
+  // record struct buf for virtio_disk_intr().
+  b->disk = 1;
+  disk.info[idx[0]].b = b;
+
+  submit(idx, sector, (uint64) b->data, BSIZE, write);
 
   __sync_synchronize();
 
   *R(VIRTIO_MMIO_QUEUE_NOTIFY) = 0; // value is queue number
 
   // Wait for virtio_disk_intr() to say request has finished.
+  iowait(1);
   while(b->disk == 1) {
     sleep(b, &disk.vdisk_lock);
   }
+  iowait(0);
 
   disk.info[idx[0]].b = 0;
   free_chain(idx[0]);
@@ -291,6 +325,58 @@ virtio_disk_rw(struct buf *b, int write)
   release(&disk.vdisk_lock);
 }
 
+// Transfer n whole pages, pages[i] to or from the PGSIZE bytes
+// of disk starting at block blocknos[i]. Puts as many requests
+// in flight at once as there are free descriptors, with one
+// notify per batch, and returns when all n are done.
+// Used by the swap code; bypasses the buffer cache.
+void
+virtio_disk_rwpages(uint *blocknos, char **pages, int n, int write)
+{
+  int heads[NUM/3];
+  int npending;
+
+  acquire(&disk.vdisk_lock);
+
+  for(int i = 0; i < n; ){
+    int k = 0;
+    int idx[3];
+
+    npending = 0;
+    while(i + k < n && k < NELEM(heads) && alloc3_desc(idx) == 0){
+      disk.info[idx[0]].b = 0;
+      disk.info[idx[0]].npending = &npending;
+      npending++;
+      submit(idx, (uint64)blocknos[i+k] * (BSIZE / 512),
+             (uint64) pages[i+k], PGSIZE, write);
+      heads[k++] = idx[0];
+    }
+    if(k == 0){
+      // other requests hold all the descriptors.
+      sleep(&disk.free[0], &disk.vdisk_lock);
+      continue;
+    }
+
+    __sync_synchronize();
+
+    *R(VIRTIO_MMIO_QUEUE_NOTIFY) = 0; // value is queue number
+
+    // Wait for virtio_disk_intr() to finish the whole batch.
+    iowait(1);
+    while(npending > 0)
+      sleep(&npending, &disk.vdisk_lock);
+    iowait(0);
+
+    for(int j = 0; j < k; j++){
+      disk.info[heads[j]].npending = 0;
+      free_chain(heads[j]);
+    }
+    i += k;
+  }
+
+  release(&disk.vdisk_lock);
+}
+
 void
 virtio_disk_intr()
 {
@@ -317,8 +403,12 @@ virtio_disk_intr()
       panic("virtio_disk_intr status");
 
     struct buf *b = disk.info[id].b;
-    b->disk = 0;   // disk is done with buf
-    wakeup(b);
+    if(b){
+      b->disk = 0;   // disk is done with buf
+      wakeup(b);
+    } else if(--*disk.info[id].npending == 0){
+      wakeup(disk.info[id].npending);
+    }
 
     disk.used_idx += 1;
   }
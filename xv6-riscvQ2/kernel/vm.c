@@ -19,7 +19,12 @@ extern char etext[];  // kernel.ld sets this to end of kernel code.
 
 extern char trampoline[]; // trampoline.S
 
-extern struct proc proc[NPROC];
+// mapped read-only at every lazily allocated user page that
+// has been read but not yet written.
+__attribute__ ((aligned (PGSIZE))) char zeropage[PGSIZE];
+
+static int faultin(struct proc*, pagetable_t, uint64, int);
+static int cowfault(struct proc*, uint64, pte_t*);
 
 // Make a direct-map page table for the kernel.
 pagetable_t
@@ -36,6 +41,9 @@ kvmmake(void)
   // virtio mmio disk interface
   kvmmap(kpgtbl, VIRTIO0, VIRTIO0, PGSIZE, PTE_R | PTE_W);
 
+  // CLINT, to send other harts software interrupts.
+  kvmmap(kpgtbl, CLINT, CLINT, 0x10000, PTE_R | PTE_W);
+
   // PLIC
   kvmmap(kpgtbl, PLIC, PLIC, 0x4000000, PTE_R | PTE_W);
 
@@ -80,7 +88,14 @@ kvminithart()
   // wait for any previous writes to the page table memory to finish.
   sfence_vma();
 
-  w_satp(MAKE_SATP(kernel_pagetable));
+  // processes use ASIDs 1..NPROC; see how many bits of
+  // ASID this hart implements.
+  w_satp(MAKE_SATP(kernel_pagetable, 0xffff));
+  uint64 asids = ((r_satp() & SATP_ASID_MASK) >> SATP_ASID_SHIFT) + 1;
+  if(asids <= NPROC)
+    panic("kvminithart: too few ASIDs");
+
+  w_satp(MAKE_SATP(kernel_pagetable, 0));
 
   // flush stale entries from the TLB.
   sfence_vma();
@@ -109,9 +124,8 @@ walk(pagetable_t pagetable, uint64 va, int alloc)
     if(*pte & PTE_V) {
       pagetable = (pagetable_t)PTE2PA(*pte);
     } else {
-      if(!alloc || (pagetable = (pde_t*)kalloc()) == 0)
+      if(!alloc || (pagetable = (pde_t*)kalloc_zeroed()) == 0)
         return 0;
-      memset(pagetable, 0, PGSIZE);
       *pte = PA2PTE(pagetable) | PTE_V;
     }
   }
@@ -183,10 +197,9 @@ pagetable_t
 uvmcreate()
 {
   pagetable_t pagetable;
-  pagetable = (pagetable_t) kalloc();
+  pagetable = (pagetable_t) kalloc_zeroed();
   if(pagetable == 0)
     return 0;
-  memset(pagetable, 0, PGSIZE);
   return pagetable;
 }
 
@@ -205,13 +218,19 @@ uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
   for(a = va; a < va + npages*PGSIZE; a += PGSIZE){
     if((pte = walk(pagetable, a, 0)) == 0) // leaf page table entry allocated?
       continue;   
-    if((*pte & PTE_V) == 0)  // has physical page been allocated?
+    if(!do_free){
+      *pte = 0;
       continue;
-    if(do_free){
-      uint64 pa = PTE2PA(*pte);
-      kfree((void*)pa);
     }
-    *pte = 0;
+    pte_t old = mruunmap(pte);
+    if(old & PTE_V){
+      // the page may still be mapped by others after a fork.
+      uint64 pa = PTE2PA(old);
+      if(pa != (uint64)zeropage && kderef((void*)pa) == 0)
+        dec_user_pages();
+    } else if(old & PTE_SWAPPED){
+      swapfree(PTE2SLOT(old));
+    }
   }
 }
 
@@ -232,33 +251,37 @@ uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz, int xperm)
     // Check if we can allocate another user page
     while(!can_alloc_user_page()) {
       //printf("uvmalloc: user page limit reached, evicting...\n");
-      if(evict_page() < 0) {
+      if(evict_pages(EVICTBATCH) == 0) {
         //printf("uvmalloc: cannot evict page\n");
         uvmdealloc(pagetable, a, oldsz);
         return 0;
       }
     }
 
-    mem = kalloc();
+    mem = kalloc_zeroed();
     if(mem == 0){
       printf("uvmalloc: kalloc failed\n");
       uvmdealloc(pagetable, a, oldsz);
       return 0;
     }
-    memset(mem, 0, PGSIZE);
     if(mappages(pagetable, a, PGSIZE, (uint64)mem, PTE_R|PTE_U|xperm) != 0){
       kfree(mem);
       uvmdealloc(pagetable, a, oldsz);
       return 0;
     }
-    // Increment user page counter and add to MRU
-    inc_user_pages();
+    // Add to MRU and increment user page counter. a page that
+    // isn't tracked could never be evicted, so don't keep it.
     struct proc *p = myproc();
-    if(p) {
-      mruadd(p->pid, a, (uint64)mem);
-      //printf("uvmalloc: allocated page PID=%d VA=0x%lx (total user pages: %d)\n", 
-             //p->pid, a, get_user_page_count());
+    if(p){
+      pte_t *pte = walk(pagetable, a, 0);
+      if(mruadd(p, a, (uint64)mem, pte, -1, 0) < 0){
+        *pte = 0;
+        kfree(mem);
+        uvmdealloc(pagetable, a, oldsz);
+        return 0;
+      }
     }
+    inc_user_pages();
   }
   return newsz;
 }
@@ -311,34 +334,27 @@ uvmfree(pagetable_t pagetable, uint64 sz)
   freewalk(pagetable);
 }
 
-// Given a parent process's page table, copy
-// its memory into a child's page table.
-// Copies both the page table and the
-// physical memory.
+// Given a parent process's page table, give the child
+// np a page table that maps the same memory.
+// Resident pages are shared copy-on-write and swapped pages
+// share their swap slot, so nothing is copied until written.
 // returns 0 on success, -1 on failure.
 // frees any allocated pages on failure.
 int
-uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
+uvmcopy(pagetable_t old, pagetable_t new, uint64 sz, struct proc *np)
 {
-  pte_t *pte;
-  uint64 pa, i;
-  uint flags;
-  char *mem;
+  pte_t *pte, *npte;
+  uint64 i;
 
   for(i = 0; i < sz; i += PGSIZE){
     if((pte = walk(old, i, 0)) == 0)
       continue;   // page table entry hasn't been allocated
-    if((*pte & PTE_V) == 0)
+    if((*pte & (PTE_V|PTE_SWAPPED)) == 0)
       continue;   // physical page hasn't been allocated
-    pa = PTE2PA(*pte);
-    flags = PTE_FLAGS(*pte);
-    if((mem = kalloc()) == 0)
+    if((npte = walk(new, i, 1)) == 0)
       goto err;
-    memmove(mem, (char*)pa, PGSIZE);
-    if(mappages(new, i, PGSIZE, (uint64)mem, flags) != 0){
-      kfree(mem);
+    if(mrushare(np, i, pte, npte) < 0)
       goto err;
-    }
   }
   return 0;
 
@@ -373,26 +389,20 @@ copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
     va0 = PGROUNDDOWN(dstva);
     if(va0 >= MAXVA)
       return -1;
-  
-    pa0 = walkaddr(pagetable, va0);
-    if(pa0 == 0) {
-      if((pa0 = vmfault(pagetable, va0, 0)) == 0) {
-        return -1;
-      }
-    }
 
+    // forbid copyout over read-only user text pages. eviction
+    // keeps the permission bits, so a swapped PTE still has them.
     pte = walk(pagetable, va0, 0);
-    // forbid copyout over read-only user text pages.
-    if((*pte & PTE_W) == 0)
+    if(pte && (*pte & (PTE_V|PTE_SWAPPED)) && (*pte & (PTE_W|PTE_COW)) == 0)
       return -1;
 
-    // Track page access
-    track_page_access(pagetable, va0);
-      
+    if((pa0 = uvmpin(pagetable, va0, 1)) == 0)
+      return -1;
     n = PGSIZE - (dstva - va0);
     if(n > len)
       n = len;
     memmove((void *)(pa0 + (dstva - va0)), src, n);
+    mruunpin(pa0);
 
     len -= n;
     src += n;
@@ -411,20 +421,13 @@ copyin(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
 
   while(len > 0){
     va0 = PGROUNDDOWN(srcva);
-    pa0 = walkaddr(pagetable, va0);
-    if(pa0 == 0) {
-      if((pa0 = vmfault(pagetable, va0, 0)) == 0) {
-        return -1;
-      }
-    }
-
-    // Track page access
-    track_page_access(pagetable, va0);
-
+    if((pa0 = uvmpin(pagetable, va0, 0)) == 0)
+      return -1;
     n = PGSIZE - (srcva - va0);
     if(n > len)
       n = len;
     memmove(dst, (void *)(pa0 + (srcva - va0)), n);
+    mruunpin(pa0);
 
     len -= n;
     dst += n;
@@ -445,8 +448,7 @@ copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
 
   while(got_null == 0 && max > 0){
     va0 = PGROUNDDOWN(srcva);
-    pa0 = walkaddr(pagetable, va0);
-    if(pa0 == 0)
+    if((pa0 = uvmpin(pagetable, va0, 0)) == 0)
       return -1;
     n = PGSIZE - (srcva - va0);
     if(n > max)
@@ -466,6 +468,7 @@ copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
       p++;
       dst++;
     }
+    mruunpin(pa0);
 
     srcva = va0 + PGSIZE;
   }
@@ -476,81 +479,277 @@ copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
   }
 }
 
+// Pin the user page at va in pagetable, so that it stays where it
+// is while the kernel uses it through its physical address; bring
+// it in first if it isn't resident. write says the kernel will
+// store to it, so a copy-on-write page is copied first.
+// Returns the physical address, to be released with mruunpin(),
+// or 0 if va isn't user memory or can't be brought in.
+uint64
+uvmpin(pagetable_t pagetable, uint64 va, int write)
+{
+  struct proc *p = myproc();
+  pte_t *pte;
+  uint64 pa;
+
+  if(va >= MAXVA)
+    return 0;
+  va = PGROUNDDOWN(va);
+  // eviction may get in between, so try until the pin holds.
+  for(;;){
+    pte = walk(pagetable, va, 0);
+    if(pte && (pa = mrupin(pte, write)) != 0)
+      return pa;
+    if(pte && (*pte & PTE_V)){
+      // copy-on-write in p's own page table, or not user memory.
+      if(!write || (*pte & (PTE_U|PTE_COW)) != (PTE_U|PTE_COW) ||
+         pagetable != p->pagetable)
+        return 0;
+      if(cowfault(p, va, pte) < 0)
+        return 0;
+    } else if(vmfault(pagetable, va, !write) == 0){
+      return 0;
+    }
+  }
+}
+
 // allocate and map user memory if process is referencing a page
-// that was lazily allocated in sys_sbrk().
+// that was lazily allocated in sys_sbrk(), or read it back if it
+// was swapped out. a read of a lazy page maps the zero page.
+// pagetable may also be the one exec() is building, which has
+// no lazy pages but whose pages can be swapped out.
 // returns 0 if va is invalid or already mapped, or if
 // out of physical memory, and physical address if successful.
 uint64
 vmfault(pagetable_t pagetable, uint64 va, int read)
 {
-  uint64 mem;
   struct proc *p = myproc();
+  pte_t *pte;
 
-  if (va >= p->sz)
+  if(va >= MAXVA)
     return 0;
   va = PGROUNDDOWN(va);
-  if(ismapped(pagetable, va)) {
+  if(pagetable == p->pagetable){
+    if (va >= p->sz)
+      return 0;
+  } else if((pte = walk(pagetable, va, 0)) == 0 || (*pte & PTE_SWAPPED) == 0){
     return 0;
   }
-  mem = (uint64) kalloc();
-  if(mem == 0)
-    return 0;
-  memset((void *) mem, 0, PGSIZE);
-  if (mappages(p->pagetable, va, PGSIZE, mem, PTE_W|PTE_U|PTE_R) != 0) {
-    kfree((void *)mem);
+  if(ismapped(pagetable, va)) {
     return 0;
   }
-  return mem;
+  if(faultin(p, pagetable, va, !read) < 0)
+    return 0;
+  return walkaddr(pagetable, va);
 }
 
-int
-ismapped(pagetable_t pagetable, uint64 va)
+// Make the non-resident page at va resident: read it from swap,
+// or if sbrk() allocated it lazily, give it a zeroed page, or
+// just map the shared zero page if the fault is not a write. If
+// the faults are moving forward through memory, do the same for
+// up to p->ra of the pages after it, reading all the swapped
+// ones in one burst of disk requests. The window doubles for each
+// fault that follows on, and mruevict() halves it whenever a
+// page read ahead is evicted unused. Read-ahead never evicts;
+// it only takes user pages that are free (kswapd keeps some).
+// pagetable is p's, or the one exec() is building for p, in
+// which only the page at va is brought in.
+// Returns 0, or -1 if the page at va could not be brought in.
+static int
+faultin(struct proc *p, pagetable_t pagetable, uint64 va, int write)
 {
-  pte_t *pte = walk(pagetable, va, 0);
-  if (pte == 0) {
-    return 0;
+  uint64 vas[MAXREADAHEAD+1];
+  pte_t *ptes[MAXREADAHEAD+1];
+  char *mems[MAXREADAHEAD+1];
+  int slots[MAXREADAHEAD+1];
+  int i, nswap, n, err;
+  uint64 a, last;
+
+  last = va;
+  if(pagetable == p->pagetable) {
+    if(va > p->lastfault && va <= p->ranext)
+      p->ra = p->ra ? p->ra * 2 : 1;
+    else
+      p->ra = 0;
+    if(p->ra > MAXREADAHEAD)
+      p->ra = MAXREADAHEAD;
+    last = va + p->ra*PGSIZE;
+    if(last >= p->sz)
+      last = PGROUNDDOWN(p->sz - 1);
   }
-  if (*pte & PTE_V){
-    return 1;
+
+  nswap = 0;
+  n = 0;
+  err = 0;
+  for(a = va; a <= last; a += PGSIZE) {
+    pte_t *pte = walk(pagetable, a, 0);
+    if(pte && (*pte & PTE_V))
+      continue;   // already resident
+
+    if(!write && (pte == 0 || (*pte & PTE_SWAPPED) == 0)) {
+      // lazily allocated, and only read so far.
+      if(mappages(pagetable, a, PGSIZE, (uint64)zeropage, PTE_U|PTE_R|PTE_COW) != 0) {
+        if(a == va)
+          return -1;
+        break;
+      }
+      continue;
+    }
+
+    if(a == va) {
+      while(!can_alloc_user_page()) {
+        if(evict_pages(EVICTBATCH) == 0) {
+          printf("Cannot evict page for page-in\n");
+          return -1;
+        }
+      }
+    } else if(!can_alloc_user_page()) {
+      break;
+    }
+
+    // a page coming back from swap is overwritten anyway.
+    char *mem = (pte && (*pte & PTE_SWAPPED)) ? kalloc() : kalloc_zeroed();
+    if(mem == 0) {
+      if(a == va) {
+        printf("kalloc failed for page-in\n");
+        return -1;
+      }
+      break;
+    }
+    // count it now, so can_alloc_user_page() sees it.
+    inc_user_pages();
+
+    if(pte && (*pte & PTE_SWAPPED)) {
+      vas[nswap] = a;
+      ptes[nswap] = pte;
+      mems[nswap] = mem;
+      slots[nswap] = PTE2SLOT(*pte);
+      nswap++;
+    } else {
+      // lazily allocated by sbrk(): a zero page.
+      if(mappages(pagetable, a, PGSIZE, (uint64)mem, PTE_W|PTE_U|PTE_R) != 0) {
+        kfree(mem);
+        dec_user_pages();
+        if(a == va)
+          return -1;
+        break;
+      }
+      pte = walk(pagetable, a, 0);
+      if(mruadd(p, a, (uint64)mem, pte, -1, a == va ? 0 : p) < 0) {
+        // untracked, it could never be evicted.
+        *pte = 0;
+        kfree(mem);
+        dec_user_pages();
+        if(a == va)
+          return -1;
+        break;
+      }
+    }
+    if(a != va)
+      p->prefetches++;
+    n++;
   }
-  return 0;
-}
 
+  if(nswap > 0) {
+    // Swap in the pages
+    swapinv(slots, mems, nswap);
+    p->swap_ins += nswap;
+
+    for(i = 0; i < nswap; i++) {
+      // Update page table entry, keeping the page's permissions.
+      // PTE_D starts clear, so eviction can tell if the swap copy
+      // is still good.
+      pte_t *pte = ptes[i];
+      *pte = PA2PTE(mems[i]) | (PTE_FLAGS(*pte) & ~(PTE_SWAPPED|PTE_D)) | PTE_V;
+
+      // Add to MRU list, keeping the swap copy. if it can't be
+      // tracked, leave the page in swap.
+      if(mruadd(p, vas[i], (uint64)mems[i], pte, slots[i], vas[i] == va ? 0 : p) < 0) {
+        *pte = SLOT2PTE(slots[i]) | (PTE_FLAGS(*pte) & ~PTE_V) | PTE_SWAPPED;
+        kfree(mems[i]);
+        dec_user_pages();
+        if(vas[i] == va)
+          err = -1;
+        continue;
+      }
+
+      printf("Swapped in: PID=%d VA=0x%lx\n", p->pid, vas[i]);
+    }
+  }
+
+  if(pagetable == p->pagetable) {
+    p->lastfault = va;
+    p->ranext = a;
+  }
+  return err;
+}
 
-struct proc*
-findproc(int pid)
+// Handle a store to the copy-on-write page at va: give the
+// process a private copy (a zeroed page, for the zero page),
+// or if no one else maps the page any more, just make it
+// writable. mrucow() flushes the old page from other harts' TLBs;
+// handle_page_fault() flushes this one.
+// Returns 0, or -1 if out of memory.
+static int
+cowfault(struct proc *p, uint64 va, pte_t *pte)
 {
-  for(struct proc *p = proc; p < &proc[NPROC]; p++) {
-    acquire(&p->lock);
-    if(p->state != UNUSED && p->pid == pid) {
-      release(&p->lock);
-      return p;
+  char *mem = 0;
+  int r;
+
+  while((r = mrucow(p, va, pte, mem)) < 0) {
+    if(mem) {
+      kfree(mem);
+      dec_user_pages();
+      mem = 0;
+    }
+    if((*pte & PTE_V) == 0) {
+      // evicted under us; bring it back and try again.
+      if(faultin(p, p->pagetable, va, 1) < 0)
+        return -1;
+      continue;
+    }
+    if((*pte & PTE_COW) == 0)
+      return 0;
+
+    // a copy is needed.
+    while(!can_alloc_user_page()) {
+      if(evict_pages(EVICTBATCH) == 0) {
+        printf("Cannot evict page for copy-on-write\n");
+        return -1;
+      }
     }
-    release(&p->lock);
+    if(PTE2PA(*pte) == (uint64)zeropage)
+      mem = kalloc_zeroed();
+    else
+      mem = kalloc();
+    if(mem == 0)
+      return -1;
+    inc_user_pages();
+  }
+  if(r == 0 && mem) {
+    kfree(mem);
+    dec_user_pages();
   }
   return 0;
 }
 
-void
-track_page_access(pagetable_t pagetable, uint64 va)
+int
+ismapped(pagetable_t pagetable, uint64 va)
 {
-  struct proc *p = myproc();
-  if(p == 0)
-    return;
-  
   pte_t *pte = walk(pagetable, va, 0);
-  if(pte == 0 || (*pte & PTE_V) == 0)
-    return;
-  
-  //uint64 pa = PTE2PA(*pte);
-  
-  // Update MRU list - move this page to most recently used
-  mruupdate(p->pid, PGROUNDDOWN(va));
+  if (pte == 0) {
+    return 0;
+  }
+  if (*pte & PTE_V){
+    return 1;
+  }
+  return 0;
 }
 
-// Improved handle_page_fault
+
+// Improved handle_page_fault; write says if it was a store.
 int
-handle_page_fault(uint64 va)
+handle_page_fault(uint64 va, int write)
 {
   struct proc *p = myproc();
   
@@ -569,131 +768,81 @@ handle_page_fault(uint64 va)
   
   va = PGROUNDDOWN(va);
   
-  // Check if page table entry exists
+  int r;
   pte_t *pte = walk(p->pagetable, va, 0);
-  if(pte == 0) {
-    printf("Page table entry not found for VA=0x%lx\n", va);
+
+  if(pte == 0 || (*pte & PTE_V) == 0) {
+    // If page is not valid, it is swapped out or was allocated
+    // lazily by sbrk()
+    r = faultin(p, p->pagetable, va, write);
+  } else if(write && (*pte & PTE_COW)) {
+    // store to a copy-on-write page, or first store to a
+    // lazily allocated one
+    r = cowfault(p, va, pte);
+  } else if((*pte & PTE_U) == 0 || (write && (*pte & PTE_W) == 0)) {
+    // the stack guard page, or a store to a read-only page
+    printf("Invalid access at VA=0x%lx\n", va);
     return -1;
+  } else {
+    // Page is valid, just update MRU. the fault came from a
+    // stale TLB entry.
+    mruupdate(PTE2PA(*pte));
+    printf("handle_page_fault: page already valid, updated MRU\n");
+    r = 0;
   }
-  
-  // If page is not valid, it might be swapped out
-  if((*pte & PTE_V) == 0) {
-    // Check if it was swapped out
-    int swapped = 0;
-    for(int i = 0; i < p->num_swapped; i++) {
-      if(p->swapped_pages[i] == (va / PGSIZE)) {
-        swapped = 1;
-        break;
-      }
-    }
-    
-    if(!swapped) {
-      printf("Page not swapped, invalid access at VA=0x%lx\n", va);
-      return -1;
-    }
-    
-    // Need to swap in - first check if we need to evict
-    while(!can_alloc_user_page()) {
-      if(evict_page() < 0) {
-        printf("Cannot evict page for swap-in\n");
-        return -1;
-      }
-    }
-    
-    // Allocate memory for the page
-    char *mem = kalloc();
-    if(mem == 0) {
-      printf("kalloc failed for swap-in\n");
-      return -1;
-    }
-    
-    // Swap in the page
-    memset(mem, 0, PGSIZE);
-    if(swapin(p->pid, va, mem) < 0) {
-      kfree(mem);
-      printf("swapin failed\n");
-      return -1;
-    }
-    
-    p->swap_ins++;
-    
-    // Remove from swapped list
-    for(int i = 0; i < p->num_swapped; i++) {
-      if(p->swapped_pages[i] == (va / PGSIZE)) {
-        p->swapped_pages[i] = p->swapped_pages[--p->num_swapped];
-        break;
-      }
-    }
-    
-    // Update page table entry
-    //uint64 pa = (uint64)mem;
-    *pte = PA2PTE(mem) | PTE_V | PTE_R | PTE_W | PTE_U;
-    
-    // Increment user page count
-    inc_user_pages();
-    
-    // Add to MRU list
-    mruadd(p->pid, va, (uint64)mem);
-    
-    printf("Swapped in: PID=%d VA=0x%lx\n", p->pid, va);
-    
-    return 0;
-  }
-  
-  // Page is valid, just update MRU
-  mruupdate(p->pid, va);
-  printf("handle_page_fault: page already valid, updated MRU\n");
-  
-  return 0;
+
+  // this hart may have cached the old, invalid or read-only PTE.
+  if(r == 0)
+    sfence_vma_page(va, p->asid);
+  return r;
 }
 
-// Helper function to evict a page
+// Evict up to n pages (at most EVICTBATCH): take the victims off
+// the MRU list together, unmapping each from every process that
+// maps it, then write the ones without a clean swap copy to swap
+// in one burst of disk requests.
+// Returns the number of pages evicted, 0 if none could be.
 int
-evict_page(void)
+evict_pages(int n)
 {
-  struct mru_entry *victim = mruevict();
-  if(victim == 0) {
-    printf("evict_page: no victim found\n");
-    return -1;
-  }
-  
-  printf("evict_page: evicting PID=%d VA=0x%lx\n", victim->pid, victim->va);
-  
-  // Find the victim process
-  struct proc *vp = findproc(victim->pid);
-  if(vp == 0) {
-    printf("evict_page: victim process not found\n");
-    return -1;
-  }
-  
-  pte_t *pte = walk(vp->pagetable, victim->va, 0);
-  if(pte == 0 || (*pte & PTE_V) == 0) {
-    printf("evict_page: invalid victim page\n");
-    return -1;
+  struct mru_victim victims[EVICTBATCH];
+  int slots[EVICTBATCH];
+  char *pages[EVICTBATCH];
+  int i, k, nv, nout;
+
+  if(n > EVICTBATCH)
+    n = EVICTBATCH;
+  if((nv = mruevict(victims, n)) == 0) {
+    printf("evict_pages: no victim found\n");
+    return 0;
   }
-  
-  char *pa = (char*)PTE2PA(*pte);
-  
-  // Swap out the victim page
-  if(swapout(victim->pid, victim->va, pa) < 0) {
-    printf("evict_page: swapout failed\n");
-    return -1;
+
+  nout = 0;
+  for(i = 0; i < nv; i++) {
+    struct mru_victim *v = &victims[i];
+
+    printf("evict_pages: evicting PID=%d VA=0x%lx\n", v->pid, v->va);
+
+    // A clean page whose swap copy is still good went back
+    // to that slot, with no write.
+    if(v->write) {
+      slots[nout] = v->slot;
+      pages[nout] = (char*)v->pa;
+      nout++;
+    }
   }
-  
-  // Mark page as not valid (swapped out)
-  *pte = (*pte & ~PTE_V);
-  
-  // Free the physical page
-  kfree(pa);
-  dec_user_pages();
-  
-  // Update victim process stats
-  vp->swap_outs++;
-  
-  // Track swapped page
-  if(vp->num_swapped < 64) {
-    vp->swapped_pages[vp->num_swapped++] = victim->va / PGSIZE;
+
+  // Swap out the victim pages
+  if(nout > 0)
+    swapwritev(slots, pages, nout);
+
+  // Free the physical pages, once no PTE points at them
+  for(i = 0; i < nv; i++) {
+    for(k = 0; k < victims[i].nmap; k++) {
+      if(kderef((void*)victims[i].pa) == 0)
+        dec_user_pages();
+    }
   }
-  
-  return 0;
-}
\ No newline at end of file
+
+  return nv;
+}
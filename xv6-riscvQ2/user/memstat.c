@@ -0,0 +1,29 @@
+// user/memstat.c
+// Show free physical memory, and how fragmented it is: the
+// free blocks of each size in the buddy allocator.
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/memstat.h"
+#include "user/user.h"
+
+int
+main(int argc, char *argv[])
+{
+  struct memstat st;
+  uint64 above;
+
+  if(memstat(&st) < 0){
+    printf("memstat: failed\n");
+    exit(1);
+  }
+
+  printf("free pages: %ld (%ld on per-CPU lists)\n", st.free, st.cached);
+  printf("order\tpages\tblocks\tfree in blocks this big or bigger\n");
+  above = 0;
+  for(int k = MAXORDER; k >= 0; k--){
+    above += st.blocks[k] << k;
+    printf("%d\t%d\t%ld\t%ld%%\n", k, 1 << k, st.blocks[k],
+           st.free ? above * 100 / st.free : 0);
+  }
+  exit(0);
+}
@@ -0,0 +1,135 @@
+// user/pagebench.c
+// Compare page faults under each replacement policy, for a few
+// access patterns over a working set larger than user memory.
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/policy.h"
+#include "user/user.h"
+
+#define NUMPAGES 48  // more than the 40 page limit
+#define ROUNDS   4
+#define NHOT     8
+
+char *policynames[NPOLICY] = POLICYNAMES;
+
+char *mem;
+volatile char sink;
+
+void
+touch(int page)
+{
+  mem[page * 4096] += 1;
+}
+
+void
+peek(int page)
+{
+  sink = mem[page * 4096];
+}
+
+// scan all pages in order, over and over
+void
+loop(void)
+{
+  for(int r = 0; r < ROUNDS; r++)
+    for(int i = 0; i < NUMPAGES; i++)
+      touch(i);
+}
+
+// the same, but only reading, so swap copies stay good
+void
+readloop(void)
+{
+  for(int r = 0; r < ROUNDS; r++)
+    for(int i = 0; i < NUMPAGES; i++)
+      peek(i);
+}
+
+// a few hot pages, touched between each of a scan of the rest
+void
+hotcold(void)
+{
+  for(int r = 0; r < ROUNDS; r++){
+    for(int i = NHOT; i < NUMPAGES; i++){
+      for(int h = 0; h < NHOT; h++)
+        touch(h);
+      touch(i);
+    }
+  }
+}
+
+void
+randomly(void)
+{
+  unsigned int seed = 42;
+
+  for(int i = 0; i < ROUNDS * NUMPAGES; i++){
+    seed = seed * 1103515245 + 12345;
+    touch((seed / 65536) % NUMPAGES);
+  }
+}
+
+struct {
+  char *name;
+  void (*fn)(void);
+} workloads[] = {
+  { "loop", loop },
+  { "readloop", readloop },
+  { "hotcold", hotcold },
+  { "random", randomly },
+};
+
+#define NWORKLOAD (sizeof(workloads) / sizeof(workloads[0]))
+
+// run one workload in a fresh process, so each starts alike
+void
+run(int policy, int w)
+{
+  int pid = fork();
+  if(pid < 0){
+    printf("pagebench: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    struct pagestat before, after;
+
+    if((mem = sbrk(NUMPAGES * 4096)) == (char*)-1){
+      printf("pagebench: sbrk failed\n");
+      exit(1);
+    }
+    for(int i = 0; i < NUMPAGES; i++)
+      touch(i);
+    getpagestat(getpid(), &before);
+    workloads[w].fn();
+    getpagestat(getpid(), &after);
+    printf("%s\t%s\t%ld\t%ld\t%ld\t%ld/%ld\n", policynames[policy], workloads[w].name,
+           after.page_faults - before.page_faults,
+           after.swap_ins - before.swap_ins,
+           after.swap_writes - before.swap_writes,
+           after.prefetch_hits - before.prefetch_hits,
+           after.prefetches - before.prefetches);
+    exit(0);
+  }
+  wait(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int old = -1;
+
+  printf("policy\tpattern\tfaults\tswap-ins\tswap-writes\tread-ahead used\n");
+  for(int policy = 0; policy < NPOLICY; policy++){
+    int prev = setpolicy(policy);
+    if(prev < 0){
+      printf("pagebench: setpolicy failed\n");
+      exit(1);
+    }
+    if(old < 0)
+      old = prev;
+    for(int w = 0; w < NWORKLOAD; w++)
+      run(policy, w);
+  }
+  setpolicy(old);
+  exit(0);
+}
@@ -0,0 +1,28 @@
+// user/schedstat.c
+// Show the scheduling level and statistics of some processes.
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/sched.h"
+#include "user/user.h"
+
+int
+main(int argc, char *argv[])
+{
+  struct schedstat st;
+
+  if(argc < 2){
+    fprintf(2, "usage: schedstat pid...\n");
+    exit(1);
+  }
+  printf("pid\tprio\tbase\trun\twait\tswitches\n");
+  for(int i = 1; i < argc; i++){
+    int pid = atoi(argv[i]);
+    if(getschedstat(pid, &st) < 0){
+      printf("%d\tno such process\n", pid);
+      continue;
+    }
+    printf("%d\t%d\t%d\t%ld\t%ld\t%ld\n", pid, st.prio, st.base,
+           st.runticks, st.waitticks, st.nswitch);
+  }
+  exit(0);
+}
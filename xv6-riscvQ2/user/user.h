@@ -1,6 +1,8 @@
 #define SBRK_ERROR ((char *)-1)
 
 struct stat;
+struct memstat;
+struct schedstat;
 
 // system calls
 int fork(void);
@@ -55,7 +57,15 @@ struct pagestat {
   unsigned long page_faults;
   unsigned long swap_ins;
   unsigned long swap_outs;
+  unsigned long swap_writes;
+  unsigned long prefetches;
+  unsigned long prefetch_hits;
 };
 
 int getpagestat(int, struct pagestat*);
-int dumpmru(void);
\ No newline at end of file
+int dumpmru(void);
+int setpolicy(int);
+int memstat(struct memstat*);
+int setpriority(int, int);
+int getschedstat(int, struct schedstat*);
+int usleep(unsigned long);
\ No newline at end of file
@@ -7,6 +7,9 @@
 #include "kernel/syscall.h"
 #include "kernel/memlayout.h"
 #include "kernel/riscv.h"
+#include "kernel/policy.h"
+#include "kernel/memstat.h"
+#include "kernel/sched.h"
 
 //
 // Tests xv6 system calls.  usertests without arguments runs them all
@@ -2748,6 +2751,765 @@ lazy_sbrk(char *s)
   exit(0);
 }
 
+// Use more pages than may be resident, so that some are evicted
+// to swap and read back, and check that none loses its contents.
+void
+swapevict(char *s)
+{
+  enum { N = MAXUSERVMPAGES + 16 };
+  struct pagestat st0, st1;
+  char *p;
+
+  if(getpagestat(getpid(), &st0) < 0){
+    printf("%s: getpagestat failed\n", s);
+    exit(1);
+  }
+  p = sbrk(N * PGSIZE);
+  if(p == SBRK_ERROR){
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+  for(int i = 0; i < N; i++)
+    *(int*)(p + i*PGSIZE) = i + 1;
+  for(int i = 0; i < N; i++){
+    if(*(int*)(p + i*PGSIZE) != i + 1){
+      printf("%s: page %d has %d, not %d\n", s, i, *(int*)(p + i*PGSIZE), i + 1);
+      exit(1);
+    }
+  }
+  getpagestat(getpid(), &st1);
+  if(st1.swap_outs == st0.swap_outs || st1.swap_ins == st0.swap_ins){
+    printf("%s: no swapping: %ld swap-outs, %ld swap-ins\n", s,
+           st1.swap_outs - st0.swap_outs, st1.swap_ins - st0.swap_ins);
+    exit(1);
+  }
+  exit(0);
+}
+
+// Have more pages of one process swapped out at once than the
+// old table of 64 per process could record, and read them back.
+void
+swapmany(char *s)
+{
+  enum { N = MAXUSERVMPAGES + 80 };
+  char *p;
+
+  p = sbrk(N * PGSIZE);
+  if(p == SBRK_ERROR){
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+  for(int i = 0; i < N; i++)
+    *(int*)(p + i*PGSIZE) = i + 1;
+  for(int i = 0; i < N; i++){
+    if(*(int*)(p + i*PGSIZE) != i + 1){
+      printf("%s: page %d has %d, not %d\n", s, i, *(int*)(p + i*PGSIZE), i + 1);
+      exit(1);
+    }
+  }
+  exit(0);
+}
+
+// A page read back from swap and not written since keeps its swap
+// copy, so evicting it again writes nothing.
+void
+swapclean(char *s)
+{
+  enum { N = MAXUSERVMPAGES + 16 };
+  struct pagestat st0, st1;
+  uint64 outs, writes;
+  char *p;
+
+  p = sbrk(N * PGSIZE);
+  if(p == SBRK_ERROR){
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+  for(int i = 0; i < N; i++)
+    *(int*)(p + i*PGSIZE) = i + 1;
+
+  // at most the pages still resident and dirty need writing now.
+  getpagestat(getpid(), &st0);
+  for(int pass = 0; pass < 4; pass++){
+    for(int i = 0; i < N; i++){
+      if(*(int*)(p + i*PGSIZE) != i + 1){
+        printf("%s: page %d has %d, not %d\n", s, i, *(int*)(p + i*PGSIZE), i + 1);
+        exit(1);
+      }
+    }
+  }
+  getpagestat(getpid(), &st1);
+  outs = st1.swap_outs - st0.swap_outs;
+  writes = st1.swap_writes - st0.swap_writes;
+  if(outs == 0 || writes >= outs){
+    printf("%s: %ld of %ld evictions wrote to swap\n", s, writes, outs);
+    exit(1);
+  }
+  exit(0);
+}
+
+// Reading swapped pages back in order brings later ones in ahead
+// of their faults, and those get used.
+void
+readahead(char *s)
+{
+  enum { N = MAXUSERVMPAGES + 24 };
+  struct pagestat st0, st1;
+  int old;
+  char *p;
+
+  p = sbrk(N * PGSIZE);
+  if(p == SBRK_ERROR){
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+  for(int i = 0; i < N; i++)
+    *(int*)(p + i*PGSIZE) = i + 1;
+
+  // under LRU a page read ahead is not the next victim.
+  old = setpolicy(POLICY_LRU);
+  getpagestat(getpid(), &st0);
+  for(int pass = 0; pass < 2; pass++){
+    for(int i = 0; i < N; i++){
+      if(*(int*)(p + i*PGSIZE) != i + 1){
+        printf("%s: page %d has %d, not %d\n", s, i, *(int*)(p + i*PGSIZE), i + 1);
+        setpolicy(old);
+        exit(1);
+      }
+    }
+  }
+  pause(10);  // give mruscan() time to see the last pages used
+  getpagestat(getpid(), &st1);
+  setpolicy(old);
+  if(st1.prefetches == st0.prefetches || st1.prefetch_hits == st0.prefetch_hits){
+    printf("%s: %ld pages read ahead, %ld of them used\n", s,
+           st1.prefetches - st0.prefetches, st1.prefetch_hits - st0.prefetch_hits);
+    exit(1);
+  }
+  exit(0);
+}
+
+// Reading lazily allocated memory maps the shared zero page, so it
+// takes no user pages; a store then gets a page of its own.
+void
+zeroread(char *s)
+{
+  enum { N = 4 * MAXUSERVMPAGES };
+  struct pagestat st0, st1;
+  char *p;
+
+  getpagestat(getpid(), &st0);
+  p = sbrklazy(N * PGSIZE);
+  if(p == SBRK_ERROR){
+    printf("%s: sbrklazy failed\n", s);
+    exit(1);
+  }
+  for(int i = 0; i < N; i++){
+    if(*(int*)(p + i*PGSIZE) != 0){
+      printf("%s: page %d not zero\n", s, i);
+      exit(1);
+    }
+  }
+  getpagestat(getpid(), &st1);
+  if(st1.swap_outs != st0.swap_outs){
+    printf("%s: reading zero pages evicted %ld pages\n", s,
+           st1.swap_outs - st0.swap_outs);
+    exit(1);
+  }
+
+  *(int*)(p + PGSIZE) = 1;
+  if(*(int*)(p + PGSIZE) != 1 || *(int*)p != 0 || *(int*)(p + 2*PGSIZE) != 0){
+    printf("%s: store to a zero page changed its neighbours\n", s);
+    exit(1);
+  }
+  exit(0);
+}
+
+// Pages shared copy-on-write by fork() must stay private to each
+// side, though they are evicted and read back while shared.
+void
+cowswap(char *s)
+{
+  enum { N = MAXUSERVMPAGES };
+  int pid, xstatus;
+  char *p;
+
+  p = sbrk(N * PGSIZE);
+  if(p == SBRK_ERROR){
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+  for(int i = 0; i < N; i++)
+    *(int*)(p + i*PGSIZE) = i + 1;
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    for(int i = 0; i < N; i++)
+      *(int*)(p + i*PGSIZE) = -(i + 1);
+    for(int i = 0; i < N; i++){
+      if(*(int*)(p + i*PGSIZE) != -(i + 1)){
+        printf("%s: child's page %d has %d\n", s, i, *(int*)(p + i*PGSIZE));
+        exit(1);
+      }
+    }
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != 0)
+    exit(xstatus);
+  for(int i = 0; i < N; i++){
+    if(*(int*)(p + i*PGSIZE) != i + 1){
+      printf("%s: parent's page %d has %d\n", s, i, *(int*)(p + i*PGSIZE));
+      exit(1);
+    }
+  }
+  exit(0);
+}
+
+// Processes on different CPUs allocating and freeing pages at the
+// same time must never be handed the same page.
+void
+allocpar(char *s)
+{
+  enum { NCHILD = 4, N = 8, ROUNDS = 20 };
+  int pid, xstatus;
+
+  for(int c = 0; c < NCHILD; c++){
+    pid = fork();
+    if(pid < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      int tag = (getpid() << 16);
+      for(int r = 0; r < ROUNDS; r++){
+        char *p = sbrk(N * PGSIZE);
+        if(p == SBRK_ERROR){
+          printf("%s: sbrk failed\n", s);
+          exit(1);
+        }
+        for(int i = 0; i < N; i++)
+          *(int*)(p + i*PGSIZE) = tag | (r << 8) | i;
+        for(int i = 0; i < N; i++){
+          if(*(int*)(p + i*PGSIZE) != (tag | (r << 8) | i)){
+            printf("%s: page %d of round %d was overwritten\n", s, i, r);
+            exit(1);
+          }
+        }
+        if(sbrk(-(N * PGSIZE)) == SBRK_ERROR){
+          printf("%s: sbrk shrink failed\n", s);
+          exit(1);
+        }
+      }
+      exit(0);
+    }
+  }
+  for(int c = 0; c < NCHILD; c++){
+    wait(&xstatus);
+    if(xstatus != 0)
+      exit(1);
+  }
+}
+
+// Pages a process frees go back to the buddy allocator and merge
+// with their buddies again, so the free memory is all back and
+// no more single free pages are left than can be explained by
+// pages still held on the per-CPU lists. Eviction may free
+// other processes' pages meanwhile, which only adds to both.
+void
+buddymerge(char *s)
+{
+  enum { N = MAXUSERVMPAGES / 2, ROUNDS = 10 };
+  struct memstat st0, st1;
+  int pid, xstatus;
+
+  if(memstat(&st0) < 0){
+    printf("%s: memstat failed\n", s);
+    exit(1);
+  }
+  for(int r = 0; r < ROUNDS; r++){
+    pid = fork();
+    if(pid < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      char *p = sbrk(N * PGSIZE);
+      if(p == SBRK_ERROR){
+        printf("%s: sbrk failed\n", s);
+        exit(1);
+      }
+      for(int i = 0; i < N; i++)
+        p[i*PGSIZE] = i;
+      exit(0);
+    }
+    wait(&xstatus);
+    if(xstatus != 0)
+      exit(xstatus);
+  }
+  if(memstat(&st1) < 0){
+    printf("%s: memstat failed\n", s);
+    exit(1);
+  }
+  if(st1.free < st0.free){
+    printf("%s: %ld free pages before, %ld after\n", s, st0.free, st1.free);
+    exit(1);
+  }
+  // a single free page is left only if its buddy is not free, or
+  // is free but on a per-CPU list.
+  if(st1.blocks[0] > st0.blocks[0] + st1.cached + (st1.free - st0.free)){
+    printf("%s: %ld single free pages before, %ld after, %ld cached\n",
+           s, st0.blocks[0], st1.blocks[0], st1.cached);
+    exit(1);
+  }
+}
+
+// Open files and pipes come from kmalloc(), so more can be open
+// at once than the 100 the old fixed file table held.
+void
+manyfiles(char *s)
+{
+  enum { NCHILD = 12, NPIPE = 5 };   // 120 files, plus stdio
+  int ready[2], go[2], pids[NCHILD];
+  int xstatus;
+  char c;
+
+  if(pipe(ready) < 0 || pipe(go) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  for(int i = 0; i < NCHILD; i++){
+    pids[i] = fork();
+    if(pids[i] < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pids[i] == 0){
+      int fds[NPIPE][2];
+      close(ready[0]);
+      close(go[1]);
+      for(int j = 0; j < NPIPE; j++){
+        if(pipe(fds[j]) < 0){
+          printf("%s: child %d pipe %d failed\n", s, i, j);
+          write(ready[1], "x", 1);
+          exit(1);
+        }
+      }
+      // hold them all open until every child has its own.
+      write(ready[1], "x", 1);
+      read(go[0], &c, 1);
+      for(int j = 0; j < NPIPE; j++){
+        c = 'a' + j;
+        if(write(fds[j][1], &c, 1) != 1 || read(fds[j][0], &c, 1) != 1 ||
+           c != 'a' + j){
+          printf("%s: child %d pipe %d broken\n", s, i, j);
+          exit(1);
+        }
+      }
+      exit(0);
+    }
+  }
+  close(ready[1]);
+  close(go[0]);
+  for(int i = 0; i < NCHILD; i++){
+    if(read(ready[0], &c, 1) != 1)
+      break;
+  }
+  close(go[1]);
+  for(int i = 0; i < NCHILD; i++){
+    wait(&xstatus);
+    if(xstatus != 0)
+      exit(1);
+  }
+  close(ready[0]);
+}
+
+// With ASIDs the TLB is no longer flushed on every switch. Two
+// processes bouncing between each other must each see their own
+// copy of a page at the same address, and a page freed by
+// shrinking must come back zeroed, not through a stale mapping.
+void
+asidswitch(char *s)
+{
+  enum { ROUNDS = 200 };
+  int ping[2], pong[2], pid, xstatus, want;
+  char *p, c;
+
+  p = sbrk(PGSIZE);
+  if(p == SBRK_ERROR){
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+  *(int*)p = 1000;
+  if(pipe(ping) < 0 || pipe(pong) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    for(int i = 0; i < ROUNDS; i++){
+      if(read(ping[0], &c, 1) != 1)
+        exit(1);
+      want = i == 0 ? 1000 : -i;
+      if(*(int*)p != want){
+        printf("%s: child sees %d, not %d\n", s, *(int*)p, want);
+        exit(1);
+      }
+      *(int*)p = -(i + 1);
+      write(pong[1], "x", 1);
+    }
+    exit(0);
+  }
+  for(int i = 0; i < ROUNDS; i++){
+    *(int*)p = i;
+    write(ping[1], "x", 1);
+    if(read(pong[0], &c, 1) != 1)
+      break;
+    if(*(int*)p != i){
+      printf("%s: parent sees %d, not %d\n", s, *(int*)p, i);
+      exit(1);
+    }
+  }
+  wait(&xstatus);
+  if(xstatus != 0)
+    exit(xstatus);
+
+  // shrink and grow again: the page must be a fresh zero page.
+  if(sbrk(-PGSIZE) == SBRK_ERROR || (p = sbrk(PGSIZE)) == SBRK_ERROR){
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+  if(*(int*)p != 0){
+    printf("%s: regrown page has %d\n", s, *(int*)p);
+    exit(1);
+  }
+  exit(0);
+}
+
+// More runnable processes than CPUs, some always busy and some
+// sleeping and waking, must all get to run and finish: none may
+// be lost between the per-CPU run queues.
+void
+spinners(char *s)
+{
+  enum { NCHILD = 2*NCPU, ROUNDS = 20 };
+  int pid, xstatus, t0;
+
+  t0 = uptime();
+  for(int i = 0; i < NCHILD; i++){
+    pid = fork();
+    if(pid < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      for(int r = 0; r < ROUNDS; r++){
+        for(volatile int j = 0; j < 100000; j++)
+          ;
+        if(i & 1)
+          pause(1);
+      }
+      exit(0);
+    }
+  }
+  for(int i = 0; i < NCHILD; i++){
+    wait(&xstatus);
+    if(xstatus != 0)
+      exit(1);
+  }
+  if(uptime() - t0 > 1000){
+    printf("%s: took %d ticks\n", s, uptime() - t0);
+    exit(1);
+  }
+}
+
+// setpriority() and getschedstat() agree, and a process that uses
+// up its time slices drops below priority 0.
+void
+schedprio(char *s)
+{
+  struct schedstat st;
+  int pid, old;
+
+  if((old = setpriority(getpid(), NPRIO - 1)) < 0){
+    printf("%s: setpriority failed\n", s);
+    exit(1);
+  }
+  if(getschedstat(getpid(), &st) < 0 || st.base != NPRIO - 1){
+    printf("%s: base priority %d, not %d\n", s, st.base, NPRIO - 1);
+    exit(1);
+  }
+  setpriority(getpid(), old);
+  if(setpriority(getpid(), NPRIO) >= 0){
+    printf("%s: setpriority accepted %d\n", s, NPRIO);
+    exit(1);
+  }
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    for(;;)
+      ;
+  }
+  // every BOOSTTICKS it goes back to 0 for a tick or two.
+  for(int i = 0; i < 4*BOOSTTICKS; i++){
+    pause(1);
+    if(getschedstat(pid, &st) < 0){
+      printf("%s: getschedstat failed\n", s);
+      exit(1);
+    }
+    if(st.prio > 0 && st.runticks > 0)
+      break;
+  }
+  kill(pid);
+  wait(0);
+  if(st.prio == 0 || st.runticks == 0){
+    printf("%s: spinning child at priority %d after %ld ticks\n", s, st.prio, st.runticks);
+    exit(1);
+  }
+  exit(0);
+}
+
+// Sleepers on many channels at once, some sharing a wait queue,
+// must each be woken by a wakeup on their own channel, and a
+// sleeper killed off its queue must not disturb the others.
+void
+waitqwake(char *s)
+{
+  enum { NCHILD = 10 };
+  int fds[NCHILD][2], pids[NCHILD], xstatus;
+  char c;
+
+  for(int i = 0; i < NCHILD; i++){
+    if(pipe(fds[i]) < 0){
+      printf("%s: pipe failed\n", s);
+      exit(1);
+    }
+    pids[i] = fork();
+    if(pids[i] < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pids[i] == 0){
+      close(fds[i][1]);
+      // sleeps in piperead() until the parent writes.
+      if(read(fds[i][0], &c, 1) != 1 || c != 'a' + i)
+        exit(1);
+      exit(0);
+    }
+    close(fds[i][0]);
+  }
+  pause(2);
+
+  // kill one, then wake the rest in reverse order.
+  kill(pids[0]);
+  for(int i = NCHILD - 1; i > 0; i--){
+    c = 'a' + i;
+    if(write(fds[i][1], &c, 1) != 1){
+      printf("%s: write failed\n", s);
+      exit(1);
+    }
+  }
+  for(int i = 0; i < NCHILD; i++){
+    int pid = wait(&xstatus);
+    if(pid != pids[0] && xstatus != 0){
+      printf("%s: child %d got the wrong wakeup\n", s, pid);
+      exit(1);
+    }
+    close(fds[i][1]);
+  }
+  exit(0);
+}
+
+// With idle harts no longer ticking, pause() must still last its
+// ticks, and usleep() must wake at its deadline and not at some
+// later tick: 100ms, a 3-tick pause and 500ms finish in order.
+void
+sleeptime(char *s)
+{
+  int fds[2], t0, dt, xstatus;
+  char buf[4];
+
+  t0 = uptime();
+  pause(5);
+  dt = uptime() - t0;
+  if(dt < 5 || dt > 7){
+    printf("%s: pause(5) took %d ticks\n", s, dt);
+    exit(1);
+  }
+
+  if(pipe(fds) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  for(int i = 0; i < 3; i++){
+    int pid = fork();
+    if(pid < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      if(i == 0)
+        usleep(100000);
+      else if(i == 1)
+        pause(3 * TICKHZ / 10);
+      else
+        usleep(500000);
+      buf[0] = 'a' + i;
+      write(fds[1], buf, 1);
+      exit(0);
+    }
+  }
+  close(fds[1]);
+  for(int i = 0; i < 3; i++){
+    if(read(fds[0], buf + i, 1) != 1){
+      printf("%s: read failed\n", s);
+      exit(1);
+    }
+  }
+  buf[3] = 0;
+  for(int i = 0; i < 3; i++)
+    wait(&xstatus);
+  if(strcmp(buf, "abc") != 0){
+    printf("%s: woke in order %s, not abc\n", s, buf);
+    exit(1);
+  }
+  exit(0);
+}
+
+// Sleepers whose deadlines arrive in scrambled order must wake in
+// deadline order, and a killed sleeper must leave the others'
+// deadlines intact.
+void
+sleeporder(char *s)
+{
+  enum { N = 8, STEP = 60000 };   // usleep() units between deadlines
+  static int order[N] = { 5, 2, 7, 0, 3, 6, 1, 4 };
+  int fds[2], victim, xstatus;
+  char buf[N+1];
+
+  if(pipe(fds) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  for(int i = 0; i < N; i++){
+    int k = order[i], pid;
+    pid = fork();
+    if(pid < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      usleep((k + 1) * STEP);
+      buf[0] = '0' + k;
+      write(fds[1], buf, 1);
+      exit(0);
+    }
+  }
+  // one more sleeper, with a deadline among theirs, that is killed.
+  victim = fork();
+  if(victim < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(victim == 0){
+    usleep(N/2 * STEP + STEP/2);
+    write(fds[1], "x", 1);
+    exit(0);
+  }
+  kill(victim);
+  close(fds[1]);
+
+  for(int i = 0; i < N; i++){
+    if(read(fds[0], buf + i, 1) != 1){
+      printf("%s: read failed\n", s);
+      exit(1);
+    }
+  }
+  buf[N] = 0;
+  for(int i = 0; i < N + 1; i++)
+    wait(&xstatus);
+  for(int i = 0; i < N; i++){
+    if(buf[i] != '0' + i){
+      printf("%s: woke in order %s\n", s, buf);
+      exit(1);
+    }
+  }
+  exit(0);
+}
+
+// A process keeps storing to its pages while another forces them
+// out, so pages are evicted with stores in flight on another
+// hart. No store may be lost: a page evicted onto its old swap
+// copy would read back with an earlier round's value.
+void
+swaprace(char *s)
+{
+  enum { N = MAXUSERVMPAGES / 2, M = MAXUSERVMPAGES, ROUNDS = 200 };
+  int writer, hog, xstatus;
+  char *p;
+
+  writer = fork();
+  if(writer < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(writer == 0){
+    if((p = sbrk(N * PGSIZE)) == SBRK_ERROR){
+      printf("%s: sbrk failed\n", s);
+      exit(1);
+    }
+    for(int r = 1; r <= ROUNDS; r++){
+      for(int i = 0; i < N; i++)
+        *(int*)(p + i*PGSIZE) = r;
+      for(int i = 0; i < N; i++){
+        if(*(int*)(p + i*PGSIZE) != r){
+          printf("%s: page %d has %d in round %d\n", s, i, *(int*)(p + i*PGSIZE), r);
+          exit(1);
+        }
+      }
+    }
+    exit(0);
+  }
+
+  hog = fork();
+  if(hog < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(hog == 0){
+    if((p = sbrk(M * PGSIZE)) == SBRK_ERROR)
+      exit(1);
+    for(;;){
+      for(int i = 0; i < M; i++)
+        p[i*PGSIZE]++;
+    }
+  }
+
+  if(wait(&xstatus) == hog){
+    printf("%s: memory hog failed\n", s);
+    kill(writer);
+    wait(0);
+    exit(1);
+  }
+  kill(hog);
+  wait(0);
+  if(xstatus != 0)
+    exit(xstatus);
+  exit(0);
+}
+
 struct test {
   void (*f)(char *);
   char *s;
@@ -2816,6 +3578,22 @@ struct test {
   {lazy_unmap, "lazy_unmap"},
   {lazy_copy, "lazy_copy"},
   {lazy_sbrk, "lazy_sbrk"},
+  {swapevict, "swapevict"},
+  {swapmany, "swapmany"},
+  {swapclean, "swapclean"},
+  {readahead, "readahead"},
+  {zeroread, "zeroread"},
+  {cowswap, "cowswap"},
+  {allocpar, "allocpar"},
+  {buddymerge, "buddymerge"},
+  {manyfiles, "manyfiles"},
+  {asidswitch, "asidswitch"},
+  {spinners, "spinners"},
+  {schedprio, "schedprio"},
+  {waitqwake, "waitqwake"},
+  {sleeptime, "sleeptime"},
+  {sleeporder, "sleeporder"},
+  {swaprace, "swaprace"},
   { 0, 0},
 };
 
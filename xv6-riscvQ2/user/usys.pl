@@ -43,4 +43,9 @@ entry("sbrk");
 entry("pause");
 entry("uptime");
 entry("getpagestat");
-entry("dumpmru");
\ No newline at end of file
+entry("dumpmru");
+entry("setpolicy");
+entry("memstat");
+entry("setpriority");
+entry("getschedstat");
+entry("usleep");
\ No newline at end of file